@@ -0,0 +1,149 @@
+#include "auto_saver.hpp"
+
+#include "json_writer.hpp"
+#include "patch_writer.hpp"
+
+#include <utility>
+
+AutoSaver::AutoSaver(std::string path, std::optional<FileStamp> stamp)
+  : path_(std::move(path)), stamp_(stamp) {}
+
+AutoSaver::~AutoSaver() {
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+  }
+  condition_.notify_all();
+  if (thread_.joinable()) thread_.join();
+  // 値はドキュメントと共有しているため、複製せずに手放す
+  if (pending_) ReleaseJson(pending_->document);
+}
+
+void AutoSaver::Start(Poster poster, std::chrono::seconds interval, std::function<void()> on_tick) {
+  poster_ = std::move(poster);
+  interval_ = interval;
+  on_tick_ = std::move(on_tick);
+  thread_ = std::thread([this] { Run(); });
+}
+
+void AutoSaver::Request(Snapshot snapshot) {
+  {
+    std::lock_guard lock(mutex_);
+    if (pending_) {
+      // まだ始めていない依頼は新しい依頼に含まれる
+      snapshot.dirty.Merge(pending_->dirty);
+      ReleaseJson(pending_->document);
+    }
+    pending_ = std::move(snapshot);
+  }
+  condition_.notify_all();
+}
+
+bool AutoSaver::SaveNow(Snapshot snapshot, std::string& error) {
+  std::unique_lock lock(mutex_);
+  condition_.wait(lock, [this] { return !saving_; });
+  if (pending_) {
+    snapshot.dirty.Merge(pending_->dirty);
+    ReleaseJson(pending_->document);
+  }
+  pending_ = std::move(snapshot);
+  snapshot = Begin();
+  lock.unlock();
+  const bool saved = Write(snapshot, error);
+  ReleaseJson(snapshot.document);
+  lock.lock();
+  Finish(saved, error, snapshot.dirty);
+  return saved;
+}
+
+AutoSaver::Status AutoSaver::GetStatus() const {
+  std::lock_guard lock(mutex_);
+  Status status;
+  status.saving = saving_;
+  status.written = written_;
+  status.expected = expected_;
+  status.saved_at = saved_at_;
+  status.error = error_;
+  return status;
+}
+
+void AutoSaver::Run() {
+  std::unique_lock lock(mutex_);
+  auto next_tick = std::chrono::steady_clock::now() + interval_;
+  const auto ready = [this] { return stop_ || (pending_ && !saving_); };
+  while (!stop_) {
+    if (interval_.count() > 0) {
+      if (!condition_.wait_until(lock, next_tick, ready)) {
+        // 保存するかどうかはUIのスレッドで決める
+        next_tick = std::chrono::steady_clock::now() + interval_;
+        Post(on_tick_);
+        continue;
+      }
+    } else {
+      condition_.wait(lock, ready);
+    }
+    if (stop_) break;
+    Snapshot snapshot = Begin();
+    lock.unlock();
+    Post([] {});
+    std::string error;
+    const bool saved = Write(snapshot, error);
+    ReleaseJson(snapshot.document);
+    lock.lock();
+    Finish(saved, error, snapshot.dirty);
+    Post([] {});
+  }
+}
+
+AutoSaver::Snapshot AutoSaver::Begin() {
+  Snapshot snapshot = std::move(*pending_);
+  pending_.reset();
+  snapshot.dirty.Merge(carry_);
+  carry_.Clear();
+  saving_ = true;
+  written_ = 0;
+  expected_ = stamp_ ? stamp_->size : 0;
+  return snapshot;
+}
+
+void AutoSaver::Finish(bool saved, const std::string& error, const DirtySet& dirty) {
+  saving_ = false;
+  if (saved) {
+    saved_at_ = std::chrono::system_clock::now();
+    error_.clear();
+  } else {
+    error_ = error;
+    carry_.Merge(dirty);
+  }
+  condition_.notify_all();
+}
+
+bool AutoSaver::Write(const Snapshot& snapshot, std::string& error) {
+  const bool source_intact = stamp_ && stamp_ == FileStamp::Read(path_);
+  if (source_intact && snapshot.dirty.Empty()) return true;
+  WriteHooks hooks;
+  hooks.on_progress = [this](size_t bytes) {
+    written_ += bytes;
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_post_ < kProgressInterval) return;
+    last_post_ = now;
+    Post([] {});
+  };
+  if (snapshot.on_written) {
+    hooks.on_written = [&snapshot](int fd) {
+      if (auto stamp = FileStamp::Read(fd)) snapshot.on_written(*stamp);
+    };
+  }
+  // 元のファイルと構造が食い違ったときは全体の保存へ切り替える
+  const bool patched = source_intact && WritePatchedJsonFile(snapshot.document, path_, snapshot.dirty, path_, error, hooks);
+  if (!patched) {
+    written_ = 0;
+    if (!WriteJsonFile(snapshot.document, path_, 2, error, hooks)) return false;
+  }
+  stamp_ = FileStamp::Read(path_);
+  return true;
+}
+
+void AutoSaver::Post(std::function<void()> task) {
+  if (poster_) poster_(std::move(task));
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "dirty_set.hpp"
+#include "file_stamp.hpp"
+#include "json_types.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+/// @brief ドキュメントを専用のスレッドで保存する。
+/// 保存する値はドキュメントと構造を共有した複製でよく、constでのみ触れるため、保存中も編集を続けられる。
+/// 保存中に届いた依頼は待たせ、さらに依頼が届けば待っている依頼を新しいものに置き換える。
+/// 置き換えた依頼や失敗した保存の変更箇所は、次の保存に引き継ぐ。
+class AutoSaver {
+ public:
+  /// @brief 経過を知らせる間隔。
+  static constexpr std::chrono::milliseconds kProgressInterval{200};
+
+  /// @brief UIのスレッドで処理を実行させ、画面を描き直させる関数。
+  using Poster = std::function<void(std::function<void()>)>;
+
+  /// @brief 保存を依頼する内容。
+  struct Snapshot {
+    /// @brief ドキュメントと構造を共有した複製。
+    ordered_json document;
+    /// @brief 前回の依頼から変更されたサブツリー。
+    DirtySet dirty;
+    /// @brief 一時ファイルへ書き終え、置き換える前に保存を行うスレッドで呼ばれる。引数は一時ファイルの値。
+    std::function<void(const FileStamp&)> on_written;
+  };
+
+  /// @brief 保存の状態。
+  struct Status {
+    bool saving = false;
+    // 保存中に書いたバイト数と、書く大きさの見込み(前回のファイルの大きさ)
+    uint64_t written = 0;
+    uint64_t expected = 0;
+    // 最後に保存できた時刻
+    std::optional<std::chrono::system_clock::time_point> saved_at;
+    // 最後の保存が失敗した理由。成功すれば空になる
+    std::string error;
+  };
+
+  /// @param path 保存先のパス。
+  /// @param stamp 読み込んだときのファイルの値。
+  AutoSaver(std::string path, std::optional<FileStamp> stamp);
+  AutoSaver(const AutoSaver&) = delete;
+  AutoSaver& operator=(const AutoSaver&) = delete;
+
+  /// @brief 保存中の処理が終わるのを待って保存スレッドを止める。待っている依頼は捨てる。
+  ~AutoSaver();
+
+  /// @brief 保存スレッドを開始する。
+  /// @param poster 経過や結果を画面へ反映させる関数。保存スレッドから呼ばれる。
+  /// @param interval 保存を促す間隔。0なら促さない。
+  /// @param on_tick 間隔ごとにUIのスレッドで呼ばれる関数。
+  void Start(Poster poster, std::chrono::seconds interval, std::function<void()> on_tick);
+
+  /// @brief 保存を依頼する。保存は保存スレッドで行い、すぐに戻る。
+  /// 保存スレッドを開始していなければ、次のSaveNowまで待たせる。
+  /// @param snapshot 保存する内容。
+  void Request(Snapshot snapshot);
+
+  /// @brief 保存中の処理が終わるのを待ち、待っている依頼を引き継いで、呼び出したスレッドで保存する。
+  /// @param snapshot 保存する内容。
+  /// @param[out] error 失敗した理由。
+  /// @return 保存できたらtrue。
+  bool SaveNow(Snapshot snapshot, std::string& error);
+
+  /// @brief 保存の状態を得る。
+  Status GetStatus() const;
+
+ private:
+  /// @brief 保存スレッドの処理。
+  void Run();
+
+  /// @brief 待っている依頼を取り出して保存を始める。mutex_を持って呼ぶ。
+  Snapshot Begin();
+
+  /// @brief 保存の結果を残す。mutex_を持って呼ぶ。
+  void Finish(bool saved, const std::string& error, const DirtySet& dirty);
+
+  /// @brief ファイルが前回の保存のままなら変更箇所だけを、そうでなければ全体を書く。
+  bool Write(const Snapshot& snapshot, std::string& error);
+
+  void Post(std::function<void()> task);
+
+  const std::string path_;
+  // 前回保存した(読み込んだ)ときのファイルの値。保存中のスレッドだけが触れる
+  std::optional<FileStamp> stamp_;
+  Poster poster_;
+  std::chrono::seconds interval_{0};
+  std::function<void()> on_tick_;
+  std::thread thread_;
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  std::optional<Snapshot> pending_;
+  // 保存できなかった変更箇所
+  DirtySet carry_;
+  bool saving_ = false;
+  bool stop_ = false;
+  std::atomic<uint64_t> written_{0};
+  uint64_t expected_ = 0;
+  std::chrono::steady_clock::time_point last_post_;
+  std::optional<std::chrono::system_clock::time_point> saved_at_;
+  std::string error_;
+};
@@ -0,0 +1,61 @@
+#include "dirty_set.hpp"
+
+#include <algorithm>
+
+namespace {
+
+bool StartsWith(const std::vector<std::string>& path, const std::vector<std::string>& prefix) {
+  return path.size() >= prefix.size() && std::equal(prefix.begin(), prefix.end(), path.begin());
+}
+
+}  // namespace
+
+void DirtySet::Mark(const std::vector<std::string>& path) {
+  if (Contains(path)) return;
+  // 内側の登録は新しい登録に含まれる
+  auto first = paths_.lower_bound(path);
+  auto last = first;
+  while (last != paths_.end() && StartsWith(*last, path)) ++last;
+  paths_.erase(first, last);
+  paths_.insert(path);
+}
+
+bool DirtySet::Contains(const std::vector<std::string>& path) const {
+  if (paths_.empty()) return false;
+  std::vector<std::string> prefix;
+  prefix.reserve(path.size());
+  if (paths_.count(prefix)) return true;
+  for (const auto& key : path) {
+    prefix.push_back(key);
+    if (paths_.count(prefix)) return true;
+  }
+  return false;
+}
+
+bool DirtySet::ContainsBelow(const std::vector<std::string>& path) const {
+  auto iter = paths_.upper_bound(path);
+  return iter != paths_.end() && StartsWith(*iter, path);
+}
+
+std::vector<std::string> DirtySet::ChildrenBelow(const std::vector<std::string>& path) const {
+  std::vector<std::string> keys;
+  for (auto iter = paths_.upper_bound(path); iter != paths_.end() && StartsWith(*iter, path); ++iter) {
+    const std::string& key = (*iter)[path.size()];
+    if (keys.empty() || keys.back() != key) keys.push_back(key);
+  }
+  return keys;
+}
+
+void DirtySet::Merge(const DirtySet& other) {
+  for (const auto& path : other.paths_) {
+    Mark(path);
+  }
+}
+
+bool DirtySet::Empty() const {
+  return paths_.empty();
+}
+
+void DirtySet::Clear() {
+  paths_.clear();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+
+/// @brief 読み込んでから変更されたサブツリーの集合。
+/// 登録したパスの内側は全て変更されたものとみなし、登録済みのパスの内側は登録しない。
+/// 子の追加・削除・並べ替えは親を登録するため、登録されたパスの外側ではパスが読み込んだときと同じノードを指す。
+class DirtySet {
+ public:
+  /// @brief サブツリーを変更されたものとして登録する。
+  /// @param path 変更されたサブツリーへのパス。
+  void Mark(const std::vector<std::string>& path);
+
+  /// @brief サブツリー全体が変更されたか。パス自身か祖先が登録されていればtrue。
+  /// @param path サブツリーへのパス。
+  bool Contains(const std::vector<std::string>& path) const;
+
+  /// @brief サブツリーの内側に変更されたノードがあるか。パス自身は含まない。
+  /// @param path サブツリーへのパス。
+  bool ContainsBelow(const std::vector<std::string>& path) const;
+
+  /// @brief 子のうち、自身か内側が登録されている子のキー。
+  /// @param path 親へのパス。
+  /// @return キーの一覧。辞書順に並び、重複しない。
+  std::vector<std::string> ChildrenBelow(const std::vector<std::string>& path) const;
+
+  /// @brief 他の集合の登録を全て登録する。
+  /// @param other 同じファイルに対する変更の集合。
+  void Merge(const DirtySet& other);
+
+  /// @brief 登録が無いか。
+  bool Empty() const;
+
+  /// @brief 登録を全て消す。
+  void Clear();
+
+ private:
+  // 辞書順に並ぶため、あるパスの内側のパスはそのパスの直後に連続して並ぶ
+  std::set<std::vector<std::string>> paths_;
+};
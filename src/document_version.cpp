@@ -0,0 +1,43 @@
+#include "document_version.hpp"
+
+#include <algorithm>
+
+uint64_t DocumentVersion::Current() const {
+  return version_;
+}
+
+uint64_t DocumentVersion::Touch(const std::vector<std::string>& path) {
+  ++version_;
+  std::vector<std::string> prefix;
+  prefix.reserve(path.size());
+  subtree_versions_[prefix] = version_;
+  for (const auto& key : path) {
+    prefix.push_back(key);
+    subtree_versions_[prefix] = version_;
+  }
+  if (subtree_versions_.size() > kMaxSubtrees) Prune();
+  return version_;
+}
+
+uint64_t DocumentVersion::SubtreeVersion(const std::vector<std::string>& path) const {
+  auto iter = subtree_versions_.find(path);
+  return iter == subtree_versions_.end() ? floor_ : iter->second;
+}
+
+void DocumentVersion::Prune() {
+  std::vector<uint64_t> versions;
+  versions.reserve(subtree_versions_.size());
+  for (const auto& [path, version] : subtree_versions_) {
+    versions.push_back(version);
+  }
+  auto middle = versions.begin() + versions.size() / 2;
+  std::nth_element(versions.begin(), middle, versions.end());
+  floor_ = std::max(floor_, *middle);
+  for (auto iter = subtree_versions_.begin(); iter != subtree_versions_.end();) {
+    if (iter->second <= floor_) {
+      iter = subtree_versions_.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+}
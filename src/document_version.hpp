@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/// @brief ドキュメント全体と各サブツリーの変更バージョンを管理する。
+/// 記録するサブツリーが上限を超えたら古い変更から半分を捨てる。捨てたサブツリーは捨てた中で最も新しいバージョンで変更されたものとして扱うため、
+/// 消えたパスの記録が溜まり続けることはなく、検索結果のキャッシュは古いものが作り直されるだけで済む。
+class DocumentVersion {
+ public:
+  static constexpr size_t kMaxSubtrees = 4096;
+
+  /// @brief ドキュメント全体の現在のバージョンを得る。
+  uint64_t Current() const;
+
+  /// @brief サブツリーの変更を記録してバージョンを進める。
+  /// @param path 変更されたサブツリーへのパス。祖先のバージョンも更新される。
+  /// @return 新しいバージョン。
+  uint64_t Touch(const std::vector<std::string>& path);
+
+  /// @brief サブツリーが最後に変更されたバージョンを得る。
+  /// @param path サブツリーへのパス。
+  /// @return 変更されたバージョン。記録がなければ捨てた記録の中で最も新しいバージョンで、一度も捨てていなければ0。
+  uint64_t SubtreeVersion(const std::vector<std::string>& path) const;
+
+ private:
+  /// @brief 古い方から半分の記録を捨て、捨てた中で最も新しいバージョンをfloor_に残す。
+  void Prune();
+
+  uint64_t version_ = 0;
+  uint64_t floor_ = 0;
+  std::map<std::vector<std::string>, uint64_t> subtree_versions_;
+};
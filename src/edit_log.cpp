@@ -0,0 +1,195 @@
+#include "edit_log.hpp"
+
+namespace {
+
+void WriteVarint(std::vector<uint8_t>& buffer, uint64_t value) {
+  while (value >= 0x80) {
+    buffer.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  buffer.push_back(static_cast<uint8_t>(value));
+}
+
+uint64_t ReadVarint(const uint8_t*& data) {
+  uint64_t value = 0;
+  for (int shift = 0;; shift += 7) {
+    const uint8_t byte = *data++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (byte < 0x80) return value;
+  }
+}
+
+void WriteString(std::vector<uint8_t>& buffer, std::string_view text) {
+  WriteVarint(buffer, text.size());
+  buffer.insert(buffer.end(), text.begin(), text.end());
+}
+
+std::string_view ReadString(const uint8_t*& data) {
+  const size_t size = ReadVarint(data);
+  std::string_view text(reinterpret_cast<const char*>(data), size);
+  data += size;
+  return text;
+}
+
+// パス表の1項目が使うおおよそのバイト数。パスは表と索引の両方に持つ
+size_t EstimatePathBytes(const std::vector<std::string>& path) {
+  size_t bytes = sizeof(std::vector<std::string>) + sizeof(uint32_t);
+  for (const auto& key : path) {
+    bytes += sizeof(std::string) + key.capacity();
+  }
+  // 索引の木のノードの分を大まかに足す
+  return bytes * 2 + 4 * sizeof(void*);
+}
+
+}  // namespace
+
+bool EditOpHoldsValue(EditOpType type) {
+  switch (type) {
+    case EditOpType::kReplace:
+    case EditOpType::kAddKey:
+    case EditOpType::kRemoveKey:
+    case EditOpType::kPushElement:
+    case EditOpType::kRemoveElement:
+      return true;
+    default:
+      return false;
+  }
+}
+
+uint64_t EditLog::Append(const EditOp& op, ordered_json value) {
+  const uint64_t offset = End();
+  // 種類, フラグ, パス番号, キー, [other_key], [undo_key], index, other_index, [値の番号]
+  buffer_.push_back(static_cast<uint8_t>(op.type));
+  buffer_.push_back(op.flags);
+  WriteVarint(buffer_, op.path ? InternPath(*op.path) : InternPath({}));
+  WriteString(buffer_, op.key);
+  if (op.flags & EditOp::kHasOtherKey) WriteString(buffer_, op.other_key);
+  if (op.flags & EditOp::kHasUndoKey) WriteString(buffer_, op.undo_key);
+  WriteVarint(buffer_, op.index);
+  WriteVarint(buffer_, op.other_index);
+  if (EditOpHoldsValue(op.type)) {
+    WriteVarint(buffer_, value_base_ + values_.size());
+    values_.push_back(std::move(value));
+  } else {
+    ReleaseJson(value);
+  }
+  return offset;
+}
+
+EditOp EditLog::Read(uint64_t offset) {
+  uint64_t next = 0;
+  uint64_t slot = 0;
+  uint32_t path_id = 0;
+  EditOp op = Decode(offset, next, slot, path_id);
+  if (EditOpHoldsValue(op.type)) {
+    op.value = &values_[slot - value_base_];
+  }
+  return op;
+}
+
+void EditLog::Truncate(uint64_t offset) {
+  size_t value_count = ReleaseRange(offset, End());
+  for (; value_count > 0; --value_count) {
+    ReleaseJson(values_.back());
+    values_.pop_back();
+  }
+  buffer_.resize(offset - base_);
+  ResetIfEmpty();
+}
+
+void EditLog::DropThrough(uint64_t offset) {
+  // offsetの操作の次の位置までを捨てる
+  uint64_t position = offset;
+  uint64_t slot = 0;
+  uint32_t path_id = 0;
+  Decode(offset, position, slot, path_id);
+  size_t value_count = ReleaseRange(base_ + dead_, position);
+  for (; value_count > 0; --value_count) {
+    ReleaseJson(values_.front());
+    values_.pop_front();
+    ++value_base_;
+  }
+  dead_ = position - base_;
+  // 捨てた部分がバッファの半分を超えたら詰める
+  if (dead_ * 2 > buffer_.size()) {
+    buffer_.erase(buffer_.begin(), buffer_.begin() + dead_);
+    base_ += dead_;
+    dead_ = 0;
+  }
+  ResetIfEmpty();
+}
+
+uint64_t EditLog::End() const {
+  return base_ + buffer_.size();
+}
+
+size_t EditLog::PathBytes() const {
+  return path_bytes_;
+}
+
+EditOp EditLog::Decode(uint64_t offset, uint64_t& next, uint64_t& slot, uint32_t& path_id) {
+  const uint8_t* begin = buffer_.data() + (offset - base_);
+  const uint8_t* data = begin;
+  EditOp op;
+  op.type = static_cast<EditOpType>(*data++);
+  op.flags = *data++;
+  path_id = static_cast<uint32_t>(ReadVarint(data));
+  op.path = &paths_[path_id].path;
+  op.key = ReadString(data);
+  if (op.flags & EditOp::kHasOtherKey) op.other_key = ReadString(data);
+  if (op.flags & EditOp::kHasUndoKey) op.undo_key = ReadString(data);
+  op.index = ReadVarint(data);
+  op.other_index = ReadVarint(data);
+  if (EditOpHoldsValue(op.type)) slot = ReadVarint(data);
+  next = offset + (data - begin);
+  return op;
+}
+
+uint32_t EditLog::InternPath(const std::vector<std::string>& path) {
+  auto iter = path_ids_.find(path);
+  if (iter == path_ids_.end()) {
+    uint32_t id = static_cast<uint32_t>(paths_.size());
+    if (!free_path_ids_.empty()) {
+      id = free_path_ids_.back();
+      free_path_ids_.pop_back();
+      paths_[id].path = path;
+    } else {
+      paths_.push_back({path, 0});
+    }
+    iter = path_ids_.emplace(path, id).first;
+    path_bytes_ += EstimatePathBytes(path);
+  }
+  ++paths_[iter->second].refs;
+  return iter->second;
+}
+
+void EditLog::ReleasePath(uint32_t id) {
+  PathEntry& entry = paths_[id];
+  if (--entry.refs > 0) return;
+  path_bytes_ -= EstimatePathBytes(entry.path);
+  path_ids_.erase(entry.path);
+  std::vector<std::string>().swap(entry.path);
+  free_path_ids_.push_back(id);
+}
+
+size_t EditLog::ReleaseRange(uint64_t begin, uint64_t end) {
+  size_t value_count = 0;
+  for (uint64_t position = begin; position < end;) {
+    uint64_t slot = 0;
+    uint32_t path_id = 0;
+    if (EditOpHoldsValue(Decode(position, position, slot, path_id).type)) ++value_count;
+    ReleasePath(path_id);
+  }
+  return value_count;
+}
+
+void EditLog::ResetIfEmpty() {
+  if (End() != base_ + dead_) return;
+  buffer_.clear();
+  base_ += dead_;
+  dead_ = 0;
+  paths_.clear();
+  path_ids_.clear();
+  free_path_ids_.clear();
+  path_bytes_ = 0;
+}
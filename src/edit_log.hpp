@@ -0,0 +1,122 @@
+#pragma once
+
+#include "json_types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// @brief ログに記録する操作の種類。それぞれUndoで行う逆操作が決まっている。
+enum class EditOpType : uint8_t {
+  // keyの値を保持している値と入れ替える。逆操作も同じ入れ替え
+  kReplace,
+  // keyを追加する。逆操作はkeyを取り除いて値を保持する
+  kAddKey,
+  // indexの位置にあるkeyを取り除いて値を保持する。逆操作は保持した値でkeyを同じ位置へ戻す
+  kRemoveKey,
+  // 配列の末尾(index)に要素を追加する。逆操作は末尾を取り除いて値を保持する
+  kPushElement,
+  // 配列のindexの要素を取り除いて値を保持する。逆操作は保持した値をindexへ挿入する
+  kRemoveElement,
+  // keyをother_keyへ変更する。逆操作はother_keyをkeyへ戻す
+  kRenameKey,
+  // keyをindexが0なら1つ前へ、1なら1つ後ろへ移動する。逆操作は反対向きの移動
+  kMoveKey,
+  // keyをother_keyの直前へ移動する。逆操作はundo_keyの直前へ戻す。キーが無ければ末尾
+  kMoveKeyBefore,
+  // 配列の要素をindexからother_indexへ移動する。逆操作は反対向きの移動
+  kMoveElement,
+};
+
+/// @brief 操作が値を保持するか。
+bool EditOpHoldsValue(EditOpType type);
+
+/// @brief ログ上の1操作。
+struct EditOp {
+  static constexpr uint8_t kHasOtherKey = 1;
+  static constexpr uint8_t kHasUndoKey = 2;
+
+  EditOpType type = EditOpType::kReplace;
+  // 親ノードへのパス。ログから読んだ操作ではログのパス表を指す
+  const std::vector<std::string>* path = nullptr;
+  std::string_view key;
+  std::string_view other_key;
+  std::string_view undo_key;
+  uint64_t index = 0;
+  uint64_t other_index = 0;
+  // other_keyとundo_keyを使うか。kMoveKeyBeforeで末尾への移動を表すのに使う
+  uint8_t flags = 0;
+  // 操作が保持する値。ドキュメントに入っていない側の値で、Undo/Redoのたびに入れ替わる
+  ordered_json* value = nullptr;
+};
+
+/// @brief 編集操作を1つの連続したバッファに詰めて記録する。
+/// パスはパス表に一度だけ保存して番号で参照し、数値は可変長で書くため、単純な操作は十数バイトで済む。
+/// パス表は参照する操作の数を数え、参照する操作が無くなったパスは捨てる。
+/// 値はログの外に置き、ドキュメントと共有しているコンテナは複製しない。
+class EditLog {
+ public:
+  /// @brief 操作を末尾に追記する。
+  /// @param op 追記する操作。valueは使わない。
+  /// @param value 操作が保持する値。値を保持しない種類では捨てられる。
+  /// @return 操作の位置。
+  uint64_t Append(const EditOp& op, ordered_json value);
+
+  /// @brief 操作を読む。文字列と値はログを変更するまで有効。
+  /// @param offset 操作の位置。
+  EditOp Read(uint64_t offset);
+
+  /// @brief 指定した操作とそれより後の操作を捨てる。
+  /// @param offset 捨てる最初の操作の位置。
+  void Truncate(uint64_t offset);
+
+  /// @brief 指定した操作とそれより前の操作を捨てる。
+  /// @param offset 捨てる最後の操作の位置。
+  void DropThrough(uint64_t offset);
+
+  /// @brief 次に追記される操作の位置。
+  uint64_t End() const;
+
+  /// @brief パス表が使っているおおよそのバイト数。操作ごとのバイト数には含まれない。
+  size_t PathBytes() const;
+
+ private:
+  struct PathEntry {
+    std::vector<std::string> path;
+    // パスを参照している操作の数
+    uint32_t refs = 0;
+  };
+
+  /// @brief 操作を読み、次の操作の位置と保持する値、パスの番号を得る。
+  EditOp Decode(uint64_t offset, uint64_t& next, uint64_t& slot, uint32_t& path_id);
+
+  /// @brief パスをパス表に登録して参照を1つ増やし、その番号を返す。
+  uint32_t InternPath(const std::vector<std::string>& path);
+
+  /// @brief パスの参照を1つ減らす。参照が無くなればパス表から捨て、番号を再利用する。
+  void ReleasePath(uint32_t id);
+
+  /// @brief [begin, end)の操作が参照するパスの参照を減らし、値を保持する操作の数を数える。
+  /// @return 値を保持する操作の数。
+  size_t ReleaseRange(uint64_t begin, uint64_t end);
+
+  /// @brief 操作が1つも無くなったら、バッファとパス表を空にする。
+  void ResetIfEmpty();
+
+  std::vector<uint8_t> buffer_;
+  // buffer_[0]の位置と、先頭から捨てた操作のバイト数
+  uint64_t base_ = 0;
+  size_t dead_ = 0;
+  // 保持している値。先頭の値の番号がvalue_base_
+  std::deque<ordered_json> values_;
+  uint64_t value_base_ = 0;
+  // パス表。捨てたパスの番号はfree_path_ids_から再利用する
+  std::vector<PathEntry> paths_;
+  std::map<std::vector<std::string>, uint32_t> path_ids_;
+  std::vector<uint32_t> free_path_ids_;
+  size_t path_bytes_ = 0;
+};
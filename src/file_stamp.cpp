@@ -0,0 +1,28 @@
+#include "file_stamp.hpp"
+
+#include <sys/stat.h>
+
+namespace {
+
+FileStamp FromStatus(const struct stat& status) {
+  return FileStamp{
+    static_cast<uint64_t>(status.st_dev),
+    static_cast<uint64_t>(status.st_ino),
+    static_cast<uint64_t>(status.st_size),
+    static_cast<int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec,
+  };
+}
+
+}  // namespace
+
+std::optional<FileStamp> FileStamp::Read(const std::string& path) {
+  struct stat status;
+  if (::stat(path.c_str(), &status) != 0) return std::nullopt;
+  return FromStatus(status);
+}
+
+std::optional<FileStamp> FileStamp::Read(int fd) {
+  struct stat status;
+  if (::fstat(fd, &status) != 0) return std::nullopt;
+  return FromStatus(status);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+/// @brief ファイルの同一性を表す値。読み込んだファイルが保存までに書き換えられていないか確かめるのに使う。
+struct FileStamp {
+  uint64_t device = 0;
+  uint64_t inode = 0;
+  uint64_t size = 0;
+  int64_t modified_ns = 0;
+
+  /// @brief ファイルの現在の値を得る。
+  /// @param path ファイルのパス。
+  /// @return 得られなければnullopt。
+  static std::optional<FileStamp> Read(const std::string& path);
+
+  /// @brief 開いているファイルの現在の値を得る。
+  /// @param fd ファイルディスクリプタ。
+  /// @return 得られなければnullopt。
+  static std::optional<FileStamp> Read(int fd);
+
+  bool operator==(const FileStamp&) const = default;
+};
@@ -0,0 +1,384 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <compare>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+/// @brief 内部に空き領域(ギャップ)を持つ配列。basic_jsonのArrayTypeとして使う。
+/// 要素は1つの連続領域にギャップを挟んで保持し、挿入/削除はギャップをその位置へ動かしてから行う。
+/// 同じ付近への連続した挿入/削除は要素数によらずO(1)で済み、添字アクセスも定数時間のまま保たれる。
+/// コピーは記憶域を共有し、非constな操作を行った側が複製を持つ(コピーオンライト)。
+/// ただし非constなback()は、nlohmannのシリアライザがconstな値の配列を読み取るのに使うため複製しない。
+/// 書き換えや要素の移動には使わず、operator[]で取り出すこと。
+template <class T, class Allocator = std::allocator<T>>
+class GapArray {
+  using alloc_traits = std::allocator_traits<Allocator>;
+
+ public:
+  using value_type = T;
+  using allocator_type = Allocator;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using reference = T&;
+  using const_reference = const T&;
+  using pointer = T*;
+  using const_pointer = const T*;
+
+  /// @brief 添字で要素を指すイテレーター。ギャップの位置が変わっても同じ添字を指し続ける。
+  template <bool Const>
+  class Iterator {
+   public:
+    using iterator_category = std::random_access_iterator_tag;
+    using iterator_concept = std::random_access_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::conditional_t<Const, const T*, T*>;
+    using reference = std::conditional_t<Const, const T&, T&>;
+    using owner_type = std::conditional_t<Const, const GapArray, GapArray>;
+
+    Iterator() = default;
+
+    Iterator(owner_type* owner, size_type index) : owner_(owner), index_(index) {}
+
+    template <bool OtherConst, class = std::enable_if_t<Const && !OtherConst>>
+    Iterator(const Iterator<OtherConst>& other) : owner_(other.owner_), index_(other.index_) {}
+
+    reference operator*() const { return *owner_->Slot(index_); }
+    pointer operator->() const { return owner_->Slot(index_); }
+    reference operator[](difference_type offset) const { return *owner_->Slot(index_ + offset); }
+
+    Iterator& operator++() { ++index_; return *this; }
+    Iterator operator++(int) { Iterator old = *this; ++index_; return old; }
+    Iterator& operator--() { --index_; return *this; }
+    Iterator operator--(int) { Iterator old = *this; --index_; return old; }
+    Iterator& operator+=(difference_type offset) { index_ += offset; return *this; }
+    Iterator& operator-=(difference_type offset) { index_ -= offset; return *this; }
+
+    friend Iterator operator+(Iterator iter, difference_type offset) { return iter += offset; }
+    friend Iterator operator+(difference_type offset, Iterator iter) { return iter += offset; }
+    friend Iterator operator-(Iterator iter, difference_type offset) { return iter -= offset; }
+
+    friend difference_type operator-(const Iterator& lhs, const Iterator& rhs) {
+      return static_cast<difference_type>(lhs.index_) - static_cast<difference_type>(rhs.index_);
+    }
+
+    friend bool operator==(const Iterator& lhs, const Iterator& rhs) { return lhs.index_ == rhs.index_; }
+    friend auto operator<=>(const Iterator& lhs, const Iterator& rhs) { return lhs.index_ <=> rhs.index_; }
+
+   private:
+    friend class GapArray;
+    template <bool> friend class Iterator;
+
+    owner_type* owner_ = nullptr;
+    size_type index_ = 0;
+  };
+
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  GapArray() = default;
+
+  explicit GapArray(const Allocator&) {}
+
+  explicit GapArray(size_type count, const Allocator& = Allocator()) {
+    resize(count);
+  }
+
+  GapArray(size_type count, const T& value, const Allocator& = Allocator()) {
+    insert(cend(), count, value);
+  }
+
+  template <class InputIt, class = std::enable_if_t<!std::is_integral_v<InputIt>>>
+  GapArray(InputIt first, InputIt last, const Allocator& = Allocator()) {
+    insert(cend(), first, last);
+  }
+
+  GapArray(std::initializer_list<T> init, const Allocator& = Allocator()) {
+    insert(cend(), init.begin(), init.end());
+  }
+
+  GapArray(const GapArray& other) = default;
+  GapArray(GapArray&& other) noexcept = default;
+  GapArray& operator=(const GapArray& other) = default;
+  GapArray& operator=(GapArray&& other) noexcept = default;
+
+  allocator_type get_allocator() const noexcept { return Allocator(); }
+
+  iterator begin() { Mutable(); return {this, 0}; }
+  const_iterator begin() const noexcept { return {this, 0}; }
+  const_iterator cbegin() const noexcept { return {this, 0}; }
+  iterator end() { Mutable(); return {this, size()}; }
+  const_iterator end() const noexcept { return {this, size()}; }
+  const_iterator cend() const noexcept { return {this, size()}; }
+  reverse_iterator rbegin() { return reverse_iterator(end()); }
+  const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+  reverse_iterator rend() { return reverse_iterator(begin()); }
+  const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
+
+  bool empty() const noexcept { return size() == 0; }
+  size_type size() const noexcept { return storage_ ? storage_->Size() : 0; }
+  size_type max_size() const noexcept { return alloc_traits::max_size(Allocator()); }
+  size_type capacity() const noexcept { return storage_ ? storage_->Capacity() : 0; }
+
+  reference operator[](size_type index) { return *Mutable().Slot(index); }
+  const_reference operator[](size_type index) const { return *Slot(index); }
+
+  reference at(size_type index) {
+    if (index >= size()) throw std::out_of_range("index out of range");
+    return *Mutable().Slot(index);
+  }
+
+  const_reference at(size_type index) const {
+    if (index >= size()) throw std::out_of_range("index out of range");
+    return *Slot(index);
+  }
+
+  reference front() { return *Mutable().Slot(0); }
+  const_reference front() const { return *Slot(0); }
+  /// @brief 最後の要素。シリアライザの読み取り用で、共有中の記憶域を複製しない。書き換えには使わないこと。
+  reference back() { return *Slot(size() - 1); }
+  const_reference back() const { return *Slot(size() - 1); }
+
+  /// @brief 記憶域を他の配列と共有しているか。
+  bool IsShared() const noexcept {
+    if (!storage_) return false;
+    if (storage_.use_count() > 1) return true;
+    // 他のスレッドが手放した直後でも、そのスレッドでの読み取りを以降の書き換えより前に終わらせる
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return false;
+  }
+
+  void reserve(size_type new_capacity) {
+    if (new_capacity <= capacity()) return;
+    Storage& storage = Mutable();
+    storage.Reallocate(new_capacity, storage.GapBegin());
+  }
+
+  /// @brief 全要素を削除する。共有中の記憶域は複製せずに手放す。
+  void clear() noexcept {
+    if (IsShared()) storage_.reset();
+    else if (storage_) storage_->Clear();
+  }
+
+  template <class... Args>
+  iterator emplace(const_iterator position, Args&&... args) {
+    // 引数が自身の要素を指していてもよいよう、ギャップを動かす前に値を作る
+    T value(std::forward<Args>(args)...);
+    const size_type index = position.index_;
+    Mutable().Construct(index, 1, [&](T* slot) { alloc_traits::construct(allocator_, slot, std::move(value)); });
+    return {this, index};
+  }
+
+  iterator insert(const_iterator position, const T& value) { return emplace(position, value); }
+  iterator insert(const_iterator position, T&& value) { return emplace(position, std::move(value)); }
+
+  iterator insert(const_iterator position, size_type count, const T& value) {
+    const size_type index = position.index_;
+    if (count == 0) return {this, index};
+    T copy(value);
+    Mutable().Construct(index, count, [&](T* slot) { alloc_traits::construct(allocator_, slot, copy); });
+    return {this, index};
+  }
+
+  template <class InputIt, class = std::enable_if_t<!std::is_integral_v<InputIt>>>
+  iterator insert(const_iterator position, InputIt first, InputIt last) {
+    const size_type index = position.index_;
+    if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>) {
+      const auto count = static_cast<size_type>(std::distance(first, last));
+      if (count == 0) return {this, index};
+      Mutable().Construct(index, count, [&](T* slot) { alloc_traits::construct(allocator_, slot, *first++); });
+    } else {
+      for (size_type i = index; first != last; ++first, ++i) {
+        emplace(const_iterator(this, i), *first);
+      }
+    }
+    return {this, index};
+  }
+
+  iterator insert(const_iterator position, std::initializer_list<T> init) {
+    return insert(position, init.begin(), init.end());
+  }
+
+  void push_back(const T& value) { emplace(cend(), value); }
+  void push_back(T&& value) { emplace(cend(), std::move(value)); }
+
+  template <class... Args>
+  reference emplace_back(Args&&... args) {
+    return *emplace(cend(), std::forward<Args>(args)...);
+  }
+
+  void pop_back() { erase(cend() - 1); }
+
+  iterator erase(const_iterator position) { return erase(position, position + 1); }
+
+  iterator erase(const_iterator first, const_iterator last) {
+    const size_type index = first.index_;
+    if (last.index_ > index) Mutable().Erase(index, last.index_ - index);
+    return {this, index};
+  }
+
+  void resize(size_type count) {
+    if (count < size()) {
+      erase(cbegin() + count, cend());
+    } else if (count > size()) {
+      Mutable().Construct(size(), count - size(), [&](T* slot) { alloc_traits::construct(allocator_, slot); });
+    }
+  }
+
+  void resize(size_type count, const T& value) {
+    if (count < size()) erase(cbegin() + count, cend());
+    else insert(cend(), count - size(), value);
+  }
+
+  void swap(GapArray& other) noexcept { storage_.swap(other.storage_); }
+
+  friend void swap(GapArray& lhs, GapArray& rhs) noexcept { lhs.swap(rhs); }
+
+  friend bool operator==(const GapArray& lhs, const GapArray& rhs) {
+    return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+  }
+
+  friend auto operator<=>(const GapArray& lhs, const GapArray& rhs) {
+    return std::lexicographical_compare_three_way(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+  }
+
+ private:
+  /// @brief ギャップ付きの記憶域。[gap_begin_, gap_end_)は要素の無い領域。
+  class Storage {
+   public:
+    Storage() = default;
+
+    Storage(const Storage& other) {
+      if (other.Size() == 0) return;
+      // 複製ではギャップを末尾に置き、先頭から順に詰める
+      Reallocate(other.Size(), 0);
+      for (size_type i = 0; i < other.Size(); ++i) {
+        alloc_traits::construct(allocator_, data_ + gap_begin_, *other.Slot(i));
+        ++gap_begin_;
+      }
+    }
+
+    Storage& operator=(const Storage&) = delete;
+
+    ~Storage() {
+      Clear();
+      Deallocate();
+    }
+
+    size_type Size() const noexcept { return capacity_ - (gap_end_ - gap_begin_); }
+    size_type Capacity() const noexcept { return capacity_; }
+    size_type GapBegin() const noexcept { return gap_begin_; }
+
+    T* Slot(size_type index) const noexcept {
+      return data_ + (index < gap_begin_ ? index : index + (gap_end_ - gap_begin_));
+    }
+
+    void Clear() noexcept {
+      for (size_type i = 0; i < gap_begin_; ++i) alloc_traits::destroy(allocator_, data_ + i);
+      for (size_type i = gap_end_; i < capacity_; ++i) alloc_traits::destroy(allocator_, data_ + i);
+      gap_begin_ = 0;
+      gap_end_ = capacity_;
+    }
+
+    /// @brief 指定した添字の位置にcount個の要素を作る。constructは作る場所を受け取る。
+    template <class Fn>
+    void Construct(size_type index, size_type count, Fn&& construct) {
+      MakeGap(index, count);
+      for (size_type i = 0; i < count; ++i) {
+        construct(data_ + gap_begin_);
+        ++gap_begin_;
+      }
+    }
+
+    /// @brief 指定した添字からcount個の要素を削除する。削除する範囲をギャップに取り込む。
+    void Erase(size_type index, size_type count) {
+      MoveGap(index);
+      for (size_type i = 0; i < count; ++i) {
+        alloc_traits::destroy(allocator_, data_ + gap_end_);
+        ++gap_end_;
+      }
+    }
+
+    /// @brief 新しい領域へ要素を移し、ギャップを指定した添字の位置に置く。
+    void Reallocate(size_type new_capacity, size_type index) {
+      T* new_data = alloc_traits::allocate(allocator_, new_capacity);
+      const size_type count = Size();
+      const size_type new_gap_end = new_capacity - (count - index);
+      for (size_type i = 0; i < count; ++i) {
+        T* from = Slot(i);
+        alloc_traits::construct(allocator_, new_data + (i < index ? i : new_gap_end + (i - index)), std::move(*from));
+        alloc_traits::destroy(allocator_, from);
+      }
+      Deallocate();
+      data_ = new_data;
+      capacity_ = new_capacity;
+      gap_begin_ = index;
+      gap_end_ = new_gap_end;
+    }
+
+   private:
+    static constexpr size_type kMinCapacity = 8;
+
+    /// @brief ギャップを指定した添字の位置へ動かす。動かした距離の分だけ要素が移る。
+    void MoveGap(size_type index) {
+      // 空のギャップは要素を動かさずに置き直せる
+      if (gap_begin_ == gap_end_) {
+        gap_begin_ = gap_end_ = index;
+        return;
+      }
+      while (index < gap_begin_) {
+        --gap_begin_;
+        --gap_end_;
+        alloc_traits::construct(allocator_, data_ + gap_end_, std::move(data_[gap_begin_]));
+        alloc_traits::destroy(allocator_, data_ + gap_begin_);
+      }
+      while (index > gap_begin_) {
+        alloc_traits::construct(allocator_, data_ + gap_begin_, std::move(data_[gap_end_]));
+        alloc_traits::destroy(allocator_, data_ + gap_end_);
+        ++gap_begin_;
+        ++gap_end_;
+      }
+    }
+
+    /// @brief 指定した添字の位置に、少なくともcount個分のギャップを用意する。
+    void MakeGap(size_type index, size_type count) {
+      if (gap_end_ - gap_begin_ >= count) {
+        MoveGap(index);
+        return;
+      }
+      Reallocate(std::max({capacity_ * 2, Size() + count, kMinCapacity}), index);
+    }
+
+    void Deallocate() noexcept {
+      if (data_) alloc_traits::deallocate(allocator_, data_, capacity_);
+      data_ = nullptr;
+    }
+
+    T* data_ = nullptr;
+    size_type capacity_ = 0;
+    size_type gap_begin_ = 0;
+    size_type gap_end_ = 0;
+    [[no_unique_address]] Allocator allocator_;
+  };
+
+  T* Slot(size_type index) const noexcept { return storage_->Slot(index); }
+
+  /// @brief 書き換え用の記憶域を得る。他と共有していれば複製してから返す。
+  Storage& Mutable() {
+    if (!storage_) storage_ = std::make_shared<Storage>();
+    else if (IsShared()) storage_ = std::make_shared<Storage>(*storage_);
+    return *storage_;
+  }
+
+  std::shared_ptr<Storage> storage_;
+  [[no_unique_address]] Allocator allocator_;
+};
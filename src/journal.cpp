@@ -0,0 +1,185 @@
+#include "journal.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <unistd.h>
+
+namespace {
+
+// 保存の開始と、保存した一時ファイルの記録のキー
+constexpr const char* kSaveKey = "n";
+constexpr const char* kWrittenKey = "w";
+
+bool MatchesStamp(const ordered_json& record, const FileStamp& stamp) {
+  const auto& file = record.at("f");
+  return file.size() == 4 &&
+         file[0].get<uint64_t>() == stamp.device &&
+         file[1].get<uint64_t>() == stamp.inode &&
+         file[2].get<uint64_t>() == stamp.size &&
+         file[3].get<int64_t>() == stamp.modified_ns;
+}
+
+}  // namespace
+
+Journal::~Journal() {
+  Close(false);
+}
+
+bool Journal::Open(const std::string& path, bool truncate) {
+  Close(false);
+  const int flags = O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC | (truncate ? O_TRUNC : 0);
+  fd_ = ::open(path.c_str(), flags, 0644);
+  if (fd_ < 0) return false;
+  path_ = path;
+  stop_ = false;
+  error_.clear();
+  thread_ = std::thread([this] { Run(); });
+  return true;
+}
+
+void Journal::Append(ordered_json record) {
+  if (fd_ < 0) return;
+  {
+    std::lock_guard lock(mutex_);
+    if (error_.empty()) {
+      queue_.push_back(std::move(record));
+      ++appended_;
+    }
+  }
+  // 記録をやめた後の値はドキュメントと共有したままなので、複製せずに手放す
+  ReleaseJson(record);
+  condition_.notify_one();
+}
+
+void Journal::MarkSave(uint64_t generation) {
+  ordered_json record = ordered_json::object();
+  record[kSaveKey] = generation;
+  Append(std::move(record));
+}
+
+void Journal::MarkWritten(uint64_t generation, const FileStamp& stamp) {
+  if (fd_ < 0) return;
+  ordered_json record = ordered_json::object();
+  record[kWrittenKey] = generation;
+  record["f"] = ordered_json::array({stamp.device, stamp.inode, stamp.size, stamp.modified_ns});
+  std::unique_lock lock(mutex_);
+  if (!error_.empty()) return;
+  queue_.push_back(std::move(record));
+  const uint64_t target = ++appended_;
+  flush_ = true;
+  condition_.notify_one();
+  written_condition_.wait(lock, [this, target] { return written_ >= target || stop_; });
+}
+
+std::string Journal::Error() const {
+  std::lock_guard lock(mutex_);
+  return error_;
+}
+
+void Journal::Close(bool remove) {
+  if (fd_ < 0) return;
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+  }
+  condition_.notify_one();
+  thread_.join();
+  ::close(fd_);
+  fd_ = -1;
+  if (remove) ::unlink(path_.c_str());
+}
+
+std::vector<ordered_json> Journal::ReadRecords(const std::string& path, const std::optional<FileStamp>& file) {
+  std::vector<ordered_json> records;
+  std::ifstream input(path);
+  std::string line;
+  while (std::getline(input, line)) {
+    try {
+      records.push_back(ordered_json::parse(line));
+    } catch (...) {
+      // 書き込みの途中で終了した行より後は信用しない
+      break;
+    }
+  }
+  // ファイルが編集中に保存したものなら、その保存を開始する前の記録は既に含まれている
+  size_t first = 0;
+  if (file) {
+    for (size_t i = records.size(); i-- > 0 && first == 0;) {
+      if (!records[i].is_object() || !records[i].contains(kWrittenKey)) continue;
+      try {
+        if (!MatchesStamp(records[i], *file)) continue;
+        const auto generation = records[i].at(kWrittenKey).get<uint64_t>();
+        for (size_t j = i; j-- > 0;) {
+          if (records[j].is_object() && records[j].contains(kSaveKey) && records[j].at(kSaveKey) == generation) {
+            first = j + 1;
+            break;
+          }
+        }
+      } catch (...) {}
+    }
+  }
+  std::vector<ordered_json> edits;
+  for (size_t i = first; i < records.size(); ++i) {
+    if (records[i].is_object() && (records[i].contains(kSaveKey) || records[i].contains(kWrittenKey))) continue;
+    edits.push_back(std::move(records[i]));
+  }
+  return edits;
+}
+
+void Journal::Run() {
+  std::unique_lock lock(mutex_);
+  while (true) {
+    condition_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+    // 続けざまの編集を1回の書き込みとfsyncにまとめる
+    if (!stop_ && !flush_) condition_.wait_for(lock, kBatchInterval, [this] { return stop_ || flush_; });
+    std::vector<ordered_json> batch;
+    batch.swap(queue_);
+    flush_ = false;
+    const bool stop = stop_;
+    const bool failed = !error_.empty();
+    lock.unlock();
+    std::string buffer;
+    for (auto& record : batch) {
+      if (failed) {
+        ReleaseJson(record);
+        continue;
+      }
+      try {
+        buffer += record.dump(-1, ' ', false, ordered_json::error_handler_t::replace);
+        buffer += '\n';
+      } catch (...) {}
+      // 値はドキュメントと共有しているため、複製せずに手放す
+      ReleaseJson(record);
+    }
+    std::string error;
+    if (!buffer.empty()) {
+      if (!WriteAll(buffer)) {
+        error = std::string("write: ") + std::strerror(errno);
+      } else if (::fdatasync(fd_) != 0) {
+        error = std::string("fdatasync: ") + std::strerror(errno);
+      }
+      // 以降の保存を記録できないため、残した記録は保存済みの編集まで次に開いたときに再適用してしまう
+      if (!error.empty()) (void)::ftruncate(fd_, 0);
+    }
+    lock.lock();
+    if (!error.empty()) error_ = std::move(error);
+    written_ += batch.size();
+    written_condition_.notify_all();
+    if (stop && queue_.empty()) break;
+  }
+}
+
+bool Journal::WriteAll(const std::string& buffer) {
+  size_t written = 0;
+  while (written < buffer.size()) {
+    const ssize_t result = ::write(fd_, buffer.data() + written, buffer.size() - written);
+    if (result < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    written += result;
+  }
+  return true;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "file_stamp.hpp"
+#include "json_types.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// @brief 編集の記録を追記専用のファイルへ書き出す。
+/// 記録は1行に1つのJSONで、書き込みとfsyncは専用のスレッドがまとめて行う。
+/// 記録に含める値はドキュメントと構造を共有したままでよく、文字列への変換も書き込みスレッドで行う。
+/// 編集中の保存は、開始した位置と書いた一時ファイルを記録し、保存済みの記録を次に開いたときに再適用しないようにする。
+/// 書き込みかfsyncに失敗したら、それ以降は記録しない。保存済みの記録を再適用しないよう、ファイルの中身も捨てる。
+class Journal {
+ public:
+  /// @brief 書き込みをまとめる間隔。
+  static constexpr std::chrono::milliseconds kBatchInterval{100};
+
+  Journal() = default;
+  Journal(const Journal&) = delete;
+  Journal& operator=(const Journal&) = delete;
+
+  /// @brief 書き込み中の記録を全て書き出してから閉じる。
+  ~Journal();
+
+  /// @brief ジャーナルのファイルを開き、書き込みスレッドを開始する。
+  /// @param path ファイルのパス。
+  /// @param truncate trueなら既存の記録を捨てる。falseなら末尾に追記する。
+  /// @return 開けたらtrue。
+  bool Open(const std::string& path, bool truncate);
+
+  /// @brief 記録を追加する。書き込みは書き込みスレッドで行われる。
+  /// @param record 追加する記録。
+  void Append(ordered_json record);
+
+  /// @brief 保存の開始を記録する。これより前の記録は、この保存が済めばファイルに含まれる。
+  /// @param generation 保存ごとに異なる番号。
+  void MarkSave(uint64_t generation);
+
+  /// @brief 保存した内容を書いた一時ファイルを記録し、ファイルへ書き出されるまで待つ。置き換える前に呼ぶ。
+  /// 次に開いたときのファイルがこの一時ファイルなら、MarkSaveより前の記録は適用しない。
+  /// 書き込みスレッド以外のどのスレッドから呼んでもよい。
+  /// @param generation MarkSaveに渡した番号。
+  /// @param stamp 一時ファイルの値。
+  void MarkWritten(uint64_t generation, const FileStamp& stamp);
+
+  /// @brief 書き込みに失敗して記録をやめた理由。記録を続けていれば空。
+  std::string Error() const;
+
+  /// @brief 書き込み中の記録を全て書き出して閉じる。
+  /// @param remove trueならファイルを削除する。
+  void Close(bool remove);
+
+  /// @brief ジャーナルのファイルから、まだファイルに保存されていない編集の記録を読む。
+  /// 途中で壊れている行があれば、その手前までを返す。
+  /// @param path ジャーナルのファイルのパス。
+  /// @param file 編集するファイルの現在の値。編集中に保存したファイルなら、保存済みの記録を除く。
+  static std::vector<ordered_json> ReadRecords(const std::string& path, const std::optional<FileStamp>& file);
+
+ private:
+  /// @brief 書き込みスレッドの処理。
+  void Run();
+
+  /// @brief バッファの内容を全てファイルへ書く。
+  /// @return 書けたらtrue。失敗したらerrnoに理由が残る。
+  bool WriteAll(const std::string& buffer);
+
+  std::string path_;
+  int fd_ = -1;
+  std::thread thread_;
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  std::condition_variable written_condition_;
+  std::vector<ordered_json> queue_;
+  // 追加した記録と、書き出し終えた記録の数
+  uint64_t appended_ = 0;
+  uint64_t written_ = 0;
+  // 書き出しを待っているスレッドがあれば、まとめるのを待たずに書く
+  bool flush_ = false;
+  bool stop_ = false;
+  // 記録をやめた理由
+  std::string error_;
+};
@@ -1,41 +1,262 @@
 #include "json_editor.hpp"
 
+namespace {
+
+/// @brief 操作の前に対象のノードを指していたキー。配列ではインデックス
+std::string NodeBefore(const EditOp& op) {
+  switch (op.type) {
+    case EditOpType::kPushElement:
+    case EditOpType::kRemoveElement:
+    case EditOpType::kMoveElement:
+      return std::to_string(op.index);
+    default:
+      return std::string(op.key);
+  }
+}
+
+/// @brief 操作の後に対象のノードを指すキー。ノードが無くなる操作ではnullopt
+std::optional<std::string> NodeAfter(const EditOp& op) {
+  switch (op.type) {
+    case EditOpType::kRemoveKey:
+    case EditOpType::kRemoveElement:
+      return std::nullopt;
+    case EditOpType::kRenameKey:
+      return std::string(op.other_key);
+    case EditOpType::kPushElement:
+      return std::to_string(op.index);
+    case EditOpType::kMoveElement:
+      return std::to_string(op.other_index);
+    default:
+      return std::string(op.key);
+  }
+}
+
+/// @brief 時刻を時:分:秒で表す。millisecondsがtrueならミリ秒まで
+std::string FormatClock(std::chrono::system_clock::time_point time, bool milliseconds) {
+  const std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+  char clock[16];
+  std::strftime(clock, sizeof(clock), "%H:%M:%S", std::localtime(&seconds));
+  if (!milliseconds) return clock;
+  const auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count() % 1000;
+  char fraction[8];
+  std::snprintf(fraction, sizeof(fraction), ".%03d", static_cast<int>(millis));
+  return std::string(clock) + fraction;
+}
+
+/// @brief 場所をroot/key/...の形で表す
+std::string FormatLocation(const std::vector<std::string>& path, const std::string& focus_key) {
+  std::string location = "root";
+  for (const auto& key : path) {
+    location += "/" + key;
+  }
+  if (!focus_key.empty()) location += "/" + focus_key;
+  return location;
+}
+
+}  // namespace
+
+void HistoryManager::SetApplier(Applier applier) {
+  apply_ = std::move(applier);
+}
+
+void HistoryManager::SetObserver(Observer observer) {
+  observe_ = std::move(observer);
+}
+
+void HistoryManager::SetSnapshotter(Snapshotter snapshotter) {
+  snapshot_ = std::move(snapshotter);
+}
+
+const std::deque<HistoryBranch>& HistoryManager::Branches() const {
+  return branches_;
+}
+
+HistoryBranch HistoryManager::TakeBranch(size_t index) {
+  HistoryBranch branch = std::move(branches_.at(index));
+  branches_.erase(branches_.begin() + index);
+  return branch;
+}
+
+void HistoryManager::Push(EditAction action) {
+  HistoryEntry entry;
+  // 操作自体の大きさを加え、取り除くときに同じ値を引けるよう記録しておく
+  entry.bytes = action.bytes + sizeof(HistoryEntry) + sizeof(EditAction) + action.focus_key.capacity();
+  for (const auto& key : action.path) {
+    entry.bytes += sizeof(key) + key.capacity();
+  }
+  const HistoryView view{action.path, action.focus_key};
+  entry.action = std::make_unique<EditAction>(std::move(action));
+  DiscardRedo();
+  PushEntry(std::move(entry));
+  if (observe_) observe_(nullptr, false, view);
+}
+
+void HistoryManager::Record(const EditOp& op, json value) {
+  // Redoの履歴はログの末尾にあるため、追記する前に捨てる
+  DiscardRedo();
+  bool merge = false;
+  const bool joined = Coalesces(op, merge);
+  if (observe_) observe_(&op, false, {*op.path, NodeAfter(op).value_or(NodeBefore(op))});
+  if (merge) {
+    // 直前の操作が最初の値を保持しているため、途中の値は要らない
+    ReleaseJson(value);
+    entries_.back().time = std::chrono::system_clock::now();
+    return;
+  }
+  HistoryEntry entry;
+  entry.joined = joined;
+  entry.bytes = sizeof(HistoryEntry) + EstimateJsonBytes(value);
+  entry.offset = log_.Append(op, std::move(value));
+  entry.bytes += log_.End() - entry.offset;
+  PushEntry(std::move(entry));
+}
+
+void HistoryManager::DiscardRedo() {
+  if (cursor_ < entries_.size() && tip_) {
+    tip_->edit_count = std::count_if(entries_.begin() + cursor_, entries_.end(), [](const HistoryEntry& entry) { return !entry.joined; });
+    branches_.push_back(std::move(*tip_));
+    tip_.reset();
+    if (branches_.size() > kMaxBranches) {
+      // 先端はドキュメントと構造を共有しているため、複製せずに手放す
+      ReleaseJson(branches_.front().snapshot);
+      branches_.pop_front();
+    }
+  }
+  // ログ上の操作は項目と同じ順に並ぶため、最初に見つかった操作以降をまとめて捨てる
+  std::optional<uint64_t> first_offset;
+  for (size_t i = cursor_; i < entries_.size(); ++i) {
+    used_bytes_ -= entries_[i].bytes;
+    if (!first_offset && !entries_[i].action) first_offset = entries_[i].offset;
+  }
+  entries_.erase(entries_.begin() + cursor_, entries_.end());
+  if (first_offset) log_.Truncate(*first_offset);
+}
+
+void HistoryManager::ResetTip() {
+  if (!tip_) return;
+  ReleaseJson(tip_->snapshot);
+  tip_.reset();
+}
+
+void HistoryManager::PushEntry(HistoryEntry entry) {
+  entry.time = std::chrono::system_clock::now();
+  used_bytes_ += entry.bytes;
+  entries_.push_back(std::move(entry));
+  ++cursor_;
+  Evict();
+}
+
+bool HistoryManager::Coalesces(const EditOp& op, bool& merge) {
+  merge = false;
+  if (entries_.empty()) return false;
+  const HistoryEntry& last = entries_.back();
+  if (last.action || std::chrono::system_clock::now() - last.time > kCoalesceWindow) return false;
+  const EditOp last_op = log_.Read(last.offset);
+  if (*last_op.path != *op.path) return false;
+  const std::optional<std::string> last_node = NodeAfter(last_op);
+  if (!last_node || *last_node != NodeBefore(op)) return false;
+  merge = last_op.type == EditOpType::kReplace && op.type == EditOpType::kReplace;
+  return true;
+}
+
+void HistoryManager::SetBudget(size_t bytes) {
+  budget_ = bytes;
+  Evict();
+}
+
+size_t HistoryManager::Budget() const {
+  return budget_;
+}
+
+size_t HistoryManager::UsedBytes() const {
+  return used_bytes_ + log_.PathBytes();
+}
+
+void HistoryManager::Evict() {
+  // まとめた項目は一緒に捨てる。最新のまとまりは残す
+  while (UsedBytes() > budget_) {
+    const size_t count = GroupSize(0);
+    if (cursor_ <= count) break;
+    for (size_t i = 0; i < count; ++i) {
+      const HistoryEntry& entry = entries_.front();
+      used_bytes_ -= entry.bytes;
+      if (!entry.action) log_.DropThrough(entry.offset);
+      entries_.pop_front();
+      --cursor_;
+    }
+  }
+}
 
-void HistoryManager::Push(const EditAction& action) {
-  undo_stack_.push(action);
-  while (!redo_stack_.empty()) {
-    redo_stack_.pop();
+size_t HistoryManager::GroupSize(size_t begin) const {
+  size_t count = 1;
+  while (begin + count < entries_.size() && entries_[begin + count].joined) {
+    ++count;
   }
+  return count;
 }
 
 bool HistoryManager::CanUndo() const {
-  return !undo_stack_.empty();
+  return cursor_ > 0;
 }
 
 bool HistoryManager::CanRedo() const {
-  return !redo_stack_.empty();
+  return cursor_ < entries_.size();
+}
+
+std::optional<HistoryView> HistoryManager::Undo() {
+  if (!CanUndo()) return std::nullopt;
+  // 最新の状態から戻るときは、新しい編集で失われないよう先端を保存しておく。
+  // 先端はドキュメントと構造を共有するため、戻す操作は共有中のコンテナから値を奪わず、複製してから取り出すこと
+  const bool at_tip = cursor_ == entries_.size() && snapshot_;
+  const auto tip_time = entries_[cursor_ - 1].time;
+  json tip = at_tip ? snapshot_() : json();
+  // まとめた項目は新しい順に全て戻す
+  HistoryView view;
+  do {
+    --cursor_;
+    view = Apply(entries_[cursor_], true);
+  } while (cursor_ > 0 && entries_[cursor_].joined);
+  if (at_tip) {
+    ResetTip();
+    tip_ = HistoryBranch{std::move(tip), view, tip_time};
+  }
+  return view;
 }
 
-const EditAction* HistoryManager::Undo() {
-  if (!CanUndo()) return nullptr;
-  EditAction action = undo_stack_.top();
-  undo_stack_.pop();
-  action.undo();
-  redo_stack_.push(action);
-  return &redo_stack_.top();
+std::optional<HistoryView> HistoryManager::Redo() {
+  if (!CanRedo()) return std::nullopt;
+  HistoryView view = Apply(entries_[cursor_++], false);
+  while (cursor_ < entries_.size() && entries_[cursor_].joined) {
+    view = Apply(entries_[cursor_++], false);
+  }
+  if (cursor_ == entries_.size()) ResetTip();
+  return view;
 }
 
-const EditAction* HistoryManager::Redo() {
-  if (!CanRedo()) return nullptr;
-  EditAction action = redo_stack_.top();
-  redo_stack_.pop();
-  action.redo();
-  undo_stack_.push(action);
-  return &undo_stack_.top();
+HistoryView HistoryManager::Apply(const HistoryEntry& entry, bool undo) {
+  if (entry.action) {
+    if (undo) entry.action->undo();
+    else entry.action->redo();
+    HistoryView view{entry.action->path, entry.action->focus_key};
+    if (observe_) observe_(nullptr, undo, view);
+    return view;
+  }
+  const EditOp op = log_.Read(entry.offset);
+  HistoryView view = apply_(op, undo);
+  if (observe_) observe_(&op, undo, view);
+  return view;
 }
 
 JsonEditor::JsonEditor(json& data, const std::string& filename, std::function<void()> on_quit)
-  : input_json_(data), filename_(filename), on_quit_(on_quit), selected_tree_item_index_(0), selected_editor_tab_index_(0), search_from_root_(true) {
+  : input_json_(data), filename_(filename), on_quit_(on_quit), auto_saver_(filename, FileStamp::Read(filename)), selected_tree_item_index_(0), selected_editor_tab_index_(0), selection_anchor_(0), selection_count_(0), search_from_root_(true), branch_index_(0), timeline_step_(0), timeline_last_(0), timeline_shown_step_(0), filter_active_(false), filter_stale_(false) {
+  history_manager_.SetApplier([this](const EditOp& op, bool undo) { return ApplyEditOp(op, undo); });
+  history_manager_.SetSnapshotter([this] { return input_json_; });
+  history_manager_.SetObserver([this](const EditOp* op, bool undo, const HistoryView& view) {
+    JournalEdit(op, undo);
+    RecordTimeline(op, undo, view);
+  });
+  timeline_.Reset(input_json_);
+  SetHistoryBudget(history_budget_);
   // メインUIコンポーネント
   edit_component_ = Input(&editable_content_, "Enter value (e.g., \"text\", 123, true, null)", edit_input_option_);
   edit_component_ |= CatchEvent([this](Event event) {
@@ -51,7 +272,11 @@ JsonEditor::JsonEditor(json& data, const std::string& filename, std::function<vo
   menu_option_.entries_option.transform = [this](const EntryState& state) {
     Element element = text(state.label);
     if (0 <= state.index && state.index < entries_.size()) {
-        element |= GetColorFromType(entries_[state.index].type);
+        const TreeEntry& entry = entries_[state.index];
+        if (entry.key != ".." && entry.position < selection_.size() && selection_[entry.position]) {
+          element = text("* " + state.label) | bold;
+        }
+        element |= GetColorFromType(entry.type);
     }
     if (state.active && tree_menu_->Focused()) {
       element |= inverted;
@@ -77,6 +302,11 @@ JsonEditor::JsonEditor(json& data, const std::string& filename, std::function<vo
   rename_modal_ = BuildRenameModal();
   search_modal_ = BuildSearchModal();
   help_modal_ = BuildHelpModal();
+  convert_modal_ = BuildConvertModal();
+  sort_modal_ = BuildSortModal();
+  move_modal_ = BuildMoveModal();
+  branch_modal_ = BuildBranchModal();
+  timeline_modal_ = BuildTimelineModal();
   // 全コンポーネントの管理
   modal_container_ = Container::Tab({
     main_layout_,
@@ -85,6 +315,11 @@ JsonEditor::JsonEditor(json& data, const std::string& filename, std::function<vo
     rename_modal_,
     search_modal_,
     help_modal_,
+    convert_modal_,
+    sort_modal_,
+    move_modal_,
+    branch_modal_,
+    timeline_modal_,
   }, &modal_state_);
   // 状態初期化
   UpdateTreeEntries();
@@ -93,6 +328,120 @@ JsonEditor::JsonEditor(json& data, const std::string& filename, std::function<vo
   tree_menu_->TakeFocus();
 }
 
+void JsonEditor::SetHistoryBudget(size_t bytes) {
+  history_budget_ = bytes;
+  history_manager_.SetBudget(bytes - bytes / kTimelineShare);
+  EvictTimeline();
+}
+
+bool JsonEditor::Save(std::string& error) {
+  return auto_saver_.SaveNow(TakeSnapshot(), error);
+}
+
+void JsonEditor::StartAutoSave(AutoSaver::Poster poster, std::chrono::seconds interval) {
+  auto_saver_.Start(std::move(poster), interval, [this] {
+    // タイムラインを開いている間のドキュメントは過去の時点なので保存しない
+    if (modal_state_ != 10) RequestSave();
+  });
+}
+
+AutoSaver::Snapshot JsonEditor::TakeSnapshot() {
+  AutoSaver::Snapshot snapshot;
+  snapshot.document = input_json_;
+  snapshot.dirty = std::move(dirty_set_);
+  dirty_set_.Clear();
+  if (journal_) {
+    const uint64_t generation = ++save_generation_;
+    journal_->MarkSave(generation);
+    snapshot.on_written = [journal = journal_.get(), generation](const FileStamp& stamp) {
+      journal->MarkWritten(generation, stamp);
+    };
+  }
+  return snapshot;
+}
+
+bool JsonEditor::RequestSave() {
+  if (dirty_set_.Empty() && auto_saver_.GetStatus().error.empty()) return false;
+  auto_saver_.Request(TakeSnapshot());
+  return true;
+}
+
+Element JsonEditor::RenderSaveStatus() const {
+  const AutoSaver::Status status = auto_saver_.GetStatus();
+  if (status.saving) {
+    // 書く大きさは前回のファイルの大きさからの見込みなので、終わるまでは100%にしない
+    const std::string progress = status.expected > 0
+      ? std::to_string(std::min<uint64_t>(99, status.written * 100 / status.expected)) + "%"
+      : FormatBytes(status.written);
+    return text("Saving " + progress + " | ") | color(Color::YellowLight);
+  }
+  if (!status.error.empty()) return text("Save failed: " + status.error + " | ") | color(Color::RedLight);
+  if (status.saved_at) return text("Saved " + FormatClock(*status.saved_at, false) + " | ") | dim;
+  return text("");
+}
+
+Element JsonEditor::RenderJournalStatus() const {
+  if (!journal_) return text("");
+  const std::string error = journal_->Error();
+  if (error.empty()) return text("");
+  return text("Journal stopped: " + error + " | ") | color(Color::RedLight);
+}
+
+bool JsonEditor::StartJournal(const std::string& path, bool truncate) {
+  auto journal = std::make_unique<Journal>();
+  if (!journal->Open(path, truncate)) return false;
+  journal_ = std::move(journal);
+  journal_paths_.clear();
+  return true;
+}
+
+void JsonEditor::StopJournal(bool remove) {
+  if (!journal_) return;
+  journal_->Close(remove);
+  journal_.reset();
+}
+
+size_t JsonEditor::ReplayJournal(std::vector<json> records) {
+  size_t applied = 0;
+  for (auto& record : records) {
+    try {
+      if (record.contains("s")) {
+        // サブツリーを丸ごと置き換える記録
+        const auto path = record.at("s").get<std::vector<std::string>>();
+        if (!HasNode(path)) continue;
+        MarkModified(path);
+        GetNode(input_json_, path) = std::move(record.at("v"));
+      } else {
+        const auto path = record.at("p").get<std::vector<std::string>>();
+        const std::string key = record.value("k", "");
+        const std::string other_key = record.value("o", "");
+        const std::string undo_key = record.value("q", "");
+        json value = record.contains("v") ? std::move(record["v"]) : json();
+        EditOp op{
+          .type = static_cast<EditOpType>(record.at("t").get<int>()),
+          .path = &path,
+          .key = key,
+          .other_key = other_key,
+          .undo_key = undo_key,
+          .index = record.value("i", uint64_t{0}),
+          .other_index = record.value("j", uint64_t{0}),
+          .value = &value,
+        };
+        if (record.contains("o")) op.flags |= EditOp::kHasOtherKey;
+        if (record.contains("q")) op.flags |= EditOp::kHasUndoKey;
+        ApplyEditOp(op, record.value("u", false));
+      }
+      ++applied;
+    } catch (...) {}
+  }
+  // 再生した編集はタイムラインを通らないため、結果を1時点として残す
+  if (applied > 0) {
+    timeline_.RecordSnapshot(input_json_, {}, "");
+    EvictTimeline();
+  }
+  return applied;
+}
+
 Component JsonEditor::GetLayout() {
   return Renderer(modal_container_, [this] {
     Element document = main_layout_->Render();
@@ -121,6 +470,35 @@ Component JsonEditor::GetLayout() {
         document,
         help_modal_->Render() | clear_under | center,
       });
+    } else if (modal_state_ == 6) {
+      document = dbox({
+        document,
+        convert_modal_->Render() | clear_under | center,
+      });
+    } else if (modal_state_ == 7) {
+      document = dbox({
+        document,
+        sort_modal_->Render() | clear_under | center,
+      });
+    } else if (modal_state_ == 8) {
+      document = dbox({
+        document,
+        move_modal_->Render() | clear_under | center,
+      });
+    } else if (modal_state_ == 9) {
+      document = dbox({
+        document,
+        branch_modal_->Render() | clear_under | center,
+      });
+    } else if (modal_state_ == 10) {
+      // 木とビューアーが見えるよう、下端に表示する
+      document = dbox({
+        document,
+        vbox({
+          filler(),
+          timeline_modal_->Render() | clear_under,
+        }),
+      });
     }
     return document;
   });
@@ -152,9 +530,14 @@ Component JsonEditor::BuildMainLayout() {
   auto status_bar = Renderer([this] {
     return hbox({
       text("File: " + filename_),
+      filter_active_ ? text(" [Filter: " + filter_query_ + "]") | color(Color::YellowLight) : text(""),
+      selection_count_ > 0 ? text(" [" + std::to_string(selection_count_) + " selected]") | color(Color::CyanLight) : text(""),
       filler(),
       text(editor_hint_) | dim,
       filler(),
+      RenderJournalStatus(),
+      RenderSaveStatus(),
+      text("History: " + FormatBytes(history_manager_.UsedBytes() + timeline_.UsedBytes()) + " / " + FormatBytes(history_budget_) + " | ") | dim,
       text("[?] Help | [q] Quit") | dim,
     }) | borderLight;
   });
@@ -186,6 +569,10 @@ Component JsonEditor::BuildMainLayout() {
         if (on_quit_) on_quit_();
         return true;
       }
+      if (event == Event::Character('w')) {
+        editor_hint_ = RequestSave() ? "Saving in background..." : "No changes to save.";
+        return true;
+      }
       if (event == Event::Character('z')) {
         PerformUndo();
         return true;
@@ -198,16 +585,67 @@ Component JsonEditor::BuildMainLayout() {
         OnMoveUp();
         return true;
       }
+      if (event == Event::Character(' ')) {
+        return ToggleSelection();
+      }
+      if (event == Event::Character('v')) {
+        return SelectRange();
+      }
+      if (event == Event::Escape) {
+        if (selection_count_ == 0) return false;
+        ClearSelection();
+        return true;
+      }
+      if (event == Event::Character('c')) {
+        OnDuplicate();
+        return true;
+      }
+      if (event == Event::Character('t')) {
+        return OnOpenConvertModal();
+      }
+      if (event == Event::Character('s')) {
+        return OnOpenSortModal();
+      }
+      if (event == Event::Character('u')) {
+        OnDedupe();
+        return true;
+      }
+      if (event == Event::Character('Y')) {
+        OnYank();
+        return true;
+      }
+      if (event == Event::Character('x')) {
+        OnCut();
+        return true;
+      }
+      if (event == Event::Character('p')) {
+        OnPaste();
+        return true;
+      }
       if (event == Event::Character('J')) {
         OnMoveDown();
         return true;
       }
+      if (event == Event::Character('m')) {
+        return OnOpenMoveModal();
+      }
+      if (event == Event::Character('b')) {
+        return OnOpenBranchModal();
+      }
+      if (event == Event::Character('H')) {
+        return OnOpenTimelineModal();
+      }
       if (event == Event::Character('/')) {
         return OnOpenSearchModal();
       }
       if (event == Event::Character('?')) {
         return OnOpenHelpModal();
       }
+      if (event == Event::Character('f')) {
+        if (!filter_active_) return false;
+        ClearFilter();
+        return true;
+      }
     }
     return false;
   });
@@ -227,28 +665,43 @@ void JsonEditor::UpdateBreadcrumbComponent() {
 void JsonEditor::UpdateTreeEntries() {
   entries_.clear();
   menu_entries_.clear();
+  if (filter_active_ && !SyncFilterPath()) {
+    filter_active_ = false;
+  }
   if (!current_path_.empty()) {
     entries_.push_back({"..", "..", json::value_t::discarded});
     menu_entries_.push_back("..");
   }
-  json& node = GetNode(input_json_, current_path_);
+  // フィルタ中は一致へ至る子だけを表示し、一致数を添える
+  const uint32_t first_child = filter_active_ ? tree_filter_.FirstChild(filter_ids_.back()) : 0;
+  auto add_entry = [&](const std::string& key, const json& val, size_t position) {
+    const uint32_t id = first_child + static_cast<uint32_t>(position);
+    if (filter_active_ && !tree_filter_.Contains(id)) return;
+    std::string label = key;
+    if (val.is_object()) label += " (Object)";
+    else if (val.is_array()) label += " (Array)";
+    if (filter_active_) label += " [" + std::to_string(tree_filter_.MatchCount(id)) + "]";
+    entries_.push_back({label, key, val.type(), position});
+    menu_entries_.push_back(label);
+  };
+  const json& node = GetNode(current_path_);
+  // 選択は階層ごとに持ち、階層や要素数が変わったら解除する
+  const size_t child_count = node.is_structured() ? node.size() : 0;
+  if (selection_path_ != current_path_ || selection_.size() != child_count) {
+    selection_path_ = current_path_;
+    selection_.assign(child_count, false);
+    selection_anchor_ = 0;
+    selection_count_ = 0;
+  }
   if (node.is_object()) {
-    for (auto& [key, val] : node.items()) {
-      std::string label = key;
-      if (val.is_object()) label += " (Object)";
-      else if (val.is_array()) label += " (Array)";
-      entries_.push_back({label, key, val.type()});
-      menu_entries_.push_back(label);
+    size_t position = 0;
+    for (const auto& [key, val] : node.get_ref<const json::object_t&>()) {
+      add_entry(key, val, position++);
     }
   } else if (node.is_array()) {
-    for (size_t i = 0; i < node.size(); ++i) {
-      std::string key = std::to_string(i);
-      json& val = node[i];
-      std::string label = key;
-      if (val.is_object()) label += " (Object)";
-      else if (val.is_array()) label += " (Array)";
-      entries_.push_back({label, key, val.type()});
-      menu_entries_.push_back(label);
+    const auto& array = node.get_ref<const json::array_t&>();
+    for (size_t i = 0; i < array.size(); ++i) {
+      add_entry(std::to_string(i), array[i], i);
     }
   }
 }
@@ -263,9 +716,8 @@ void JsonEditor::OnTreeEnter() {
       path_changed = true;
     }
   } else {
-    json& node = GetNode(input_json_, current_path_);
-    json& selected_node = (node.is_array()) ? node[std::stoul(entry.key)] : node[entry.key];
-    if (selected_node.is_object() || selected_node.is_array()) {
+    const json* selected_node = FindChild(GetNode(current_path_), entry.key);
+    if (selected_node && selected_node->is_structured()) {
       current_path_.push_back(entry.key);
       path_changed = true;
     } else {
@@ -283,7 +735,7 @@ void JsonEditor::OnTreeEnter() {
 void JsonEditor::UpdateEditorPane() {
   editor_hint_ = "";
   std::string key;
-  json* selected_node = GetCurrentSelectedNode(key);
+  const json* selected_node = GetCurrentSelectedNode(key);
   if (!selected_node) {
     selected_editor_tab_index_ = 0;
     viewer_content_ = (menu_entries_.empty() || GetCurrentSelectionKey() == "[None]")
@@ -311,55 +763,27 @@ void JsonEditor::UpdateEditorPane() {
 
 void JsonEditor::OnEditorEnter() {
   std::string key;
-  json* node_ptr = GetCurrentSelectedNode(key);
+  const json* node_ptr = GetCurrentSelectedNode(key);
   if (!node_ptr) {
     tree_menu_->TakeFocus();
     return;
   }
-  json old_value = *node_ptr;
-  json& parent_node = GetNode(input_json_, current_path_);
-  UpdateJsonValue(parent_node, key, editable_content_);
-  json* new_node_ptr = nullptr;
-  if (node_ptr->is_array()) {
-    try {
-      new_node_ptr = &parent_node[std::stoul(key)];
-    } catch (...) { }
-  } else {
-    new_node_ptr = &parent_node[key];
-  }
-  if (new_node_ptr && old_value != *new_node_ptr) {
-    json new_value = *new_node_ptr;
-    std::vector<std::string> path = current_path_;
-    history_manager_.Push({
-      [this, path, key, old_value]() { ExecuteEditValue(path, key, old_value); },
-      [this, path, key, new_value]() { ExecuteEditValue(path, key, new_value); },
-      path,
-      key,
-    });
+  json new_value = ParseJsonValue(editable_content_);
+  if (new_value != *node_ptr) {
+    // ドキュメントに入っていない側の値を保持し、Undo/Redoのたびに入れ替える
+    json old_value = ExecuteEditValue(current_path_, key, std::move(new_value));
+    history_manager_.Record({.type = EditOpType::kReplace, .path = &current_path_, .key = key}, std::move(old_value));
   }
   UpdateTreeEntries();
   tree_menu_->TakeFocus();
 }
 
-void JsonEditor::UpdateJsonValue(json& parent_node, const std::string& key, const std::string& new_value) {
-  std::string cleaned_value = CleanStringForJson(new_value);
-  json* target_node = nullptr;
-  if (parent_node.is_array()) {
-    try {
-      target_node = &parent_node[std::stoul(key)];
-    } catch (...) {
-      return;
-    }
-  } else if (parent_node.is_object()) {
-    target_node = &parent_node[key];
-  } else {
-    return;
-  }
+json JsonEditor::ParseJsonValue(const std::string& text) const {
+  std::string cleaned_value = CleanStringForJson(text);
   try {
-    json parsed_value = json::parse(cleaned_value);
-    *target_node = parsed_value;
+    return json::parse(cleaned_value);
   } catch (...) {
-    *target_node = cleaned_value;
+    return json(std::move(cleaned_value));
   }
 }
 
@@ -390,7 +814,7 @@ Component JsonEditor::BuildAddModal() {
     buttons,
   });
   auto modal_renderer = Renderer(modal, [this, buttons] {
-    json& node = GetNode(input_json_, current_path_);
+    const json& node = GetNode(current_path_);
     Element input_field = nullptr;
     std::string title = "Add Entry";
     if (node.is_object()) {
@@ -411,7 +835,7 @@ Component JsonEditor::BuildAddModal() {
 }
 
 bool JsonEditor::OnOpenAddModal() {
-  json& node = GetNode(input_json_, current_path_);
+  const json& node = GetNode(current_path_);
   if (node.is_object()) {
     new_key_ = "";
     modal_state_ = 1;
@@ -428,7 +852,7 @@ bool JsonEditor::OnOpenAddModal() {
 }
 
 void JsonEditor::OnAddSubmit() {
-  json& node = GetNode(input_json_, current_path_);
+  const json& node = GetNode(current_path_);
   int new_index = -1;
   std::vector<std::string> path = current_path_;
   if (node.is_object()) {
@@ -439,29 +863,13 @@ void JsonEditor::OnAddSubmit() {
       return;
     }
     ExecuteAddKey(current_path_, cleaned_key, nullptr);
-    history_manager_.Push({
-      [this, path, cleaned_key]() { ExecuteRemoveKey(path, cleaned_key); },
-      [this, path, cleaned_key]() { ExecuteAddKey(path, cleaned_key, nullptr); },
-      path,
-      cleaned_key,
-    });
+    history_manager_.Record({.type = EditOpType::kAddKey, .path = &path, .key = cleaned_key});
     UpdateTreeEntries();
     new_index = GetIndexFromEntries(cleaned_key);
   } else if (node.is_array()) {
-    std::string cleaned_value = CleanStringForJson(new_value_);
-    json parsed_value;
-    try {
-      parsed_value = json::parse(cleaned_value);
-    } catch (...) {
-      parsed_value = cleaned_value;
-    }
-    ExecuteAddArrayElement(current_path_, parsed_value);
-    history_manager_.Push({
-      [this, path]() { ExecuteRemoveLastArrayElement(path); },
-      [this, path, parsed_value]() { ExecuteAddArrayElement(path, parsed_value); },
-      path,
-      std::to_string(node.size() - 1),
-    });
+    json parsed_value = ParseJsonValue(new_value_);
+    ExecuteAddArrayElement(current_path_, std::move(parsed_value));
+    history_manager_.Record({.type = EditOpType::kPushElement, .path = &path, .index = GetNode(path).size() - 1});
     UpdateTreeEntries();
     new_index = static_cast<int>(entries_.size() - 1);
   } else {
@@ -482,7 +890,7 @@ Component JsonEditor::BuildDeleteModal() {
       text("Are you sure you want to delete this item?") | center,
       text("This action cannnot be undone.") | center,
       separator(),
-      text("Item: " + GetCurrentSelectionKey()) | center,
+      text(selection_count_ > 0 ? "Items: " + std::to_string(selection_count_) + " selected" : "Item: " + GetCurrentSelectionKey()) | center,
       separator(),
       buttons->Render() | center,
     }) | border;
@@ -492,7 +900,7 @@ Component JsonEditor::BuildDeleteModal() {
 
 bool JsonEditor::OnOpenDeleteModal() {
   std::string key = GetCurrentSelectionKey();
-  if (key == "[None]" || key == "..") {
+  if (selection_count_ == 0 && (key == "[None]" || key == "..")) {
     editor_hint_ = "Error: Cannot delete this item.";
     return false;
   }
@@ -501,32 +909,25 @@ bool JsonEditor::OnOpenDeleteModal() {
 }
 
 void JsonEditor::OnDeleteSubmit() {
+  if (selection_count_ > 0) {
+    DeleteEntries(GetTargetPositions());
+    return;
+  }
   std::string key = GetCurrentSelectionKey();
   if (key == "[None]" || key == "..") return;
-  json& node = GetNode(input_json_, current_path_);
+  const json& node = GetNode(current_path_);
   std::vector<std::string> path = current_path_;
-  json deleted_value;
   int deleted_index = -1;
   try {
     if (node.is_object()) {
-      deleted_value = node[key];
-      ExecuteRemoveKey(current_path_, key);
-      history_manager_.Push({
-        [this, path, key, deleted_value]() { ExecuteAddKey(path, key, deleted_value); },
-        [this, path, key]() { ExecuteRemoveKey(path, key); },
-        path,
-        key,
-      });
+      // 削除した値は履歴へ移し、Undoでドキュメントへ戻す
+      const uint64_t position = entries_[selected_tree_item_index_].position;
+      json deleted_value = ExecuteRemoveKey(current_path_, key);
+      history_manager_.Record({.type = EditOpType::kRemoveKey, .path = &path, .key = key, .index = position}, std::move(deleted_value));
     } else if (node.is_array()) {
       deleted_index = std::stoul(key);
-      deleted_value = node[deleted_index];
-      ExecuteRemoveArrayElement(current_path_, deleted_index);
-      history_manager_.Push({
-        [this, path, deleted_index, deleted_value]() { ExecuteInsertArrayElement(path, deleted_index, deleted_value); },
-        [this, path, deleted_index]() { ExecuteRemoveArrayElement(path, deleted_index); },
-        path,
-        std::to_string(deleted_index > 0 ? deleted_index - 1 : 0),
-      });
+      json deleted_value = ExecuteRemoveArrayElement(current_path_, deleted_index);
+      history_manager_.Record({.type = EditOpType::kRemoveElement, .path = &path, .index = static_cast<uint64_t>(deleted_index)}, std::move(deleted_value));
     }
   } catch (...) {
     editor_hint_ = "Error: Failed to delete item.";
@@ -552,7 +953,7 @@ Component JsonEditor::BuildRenameModal() {
     buttons,
   });
   auto modal_renderer = Renderer(modal, [this, buttons] {
-    json& node = GetNode(input_json_, current_path_);
+    const json& node = GetNode(current_path_);
     if (node.is_array()) {
       return vbox({
         text("Cannot Rename an Element in an Array"),
@@ -572,7 +973,7 @@ Component JsonEditor::BuildRenameModal() {
 
 bool JsonEditor::OnOpenRenameModal() {
   std::string key = GetCurrentSelectionKey();
-  if (key == "[None]" || key == ".." || GetNode(input_json_, current_path_).is_array()) {
+  if (key == "[None]" || key == ".." || GetNode(current_path_).is_array()) {
     editor_hint_ = "Error: Cannot rename this item.";
     return false;
   }
@@ -583,7 +984,7 @@ bool JsonEditor::OnOpenRenameModal() {
 }
 
 void JsonEditor::OnRenameSubmit() {
-  json& node = GetNode(input_json_, current_path_);
+  const json& node = GetNode(current_path_);
   if (!node.is_object()) {
     modal_state_ = 0;
     tree_menu_->TakeFocus();
@@ -596,48 +997,47 @@ void JsonEditor::OnRenameSubmit() {
     return;
   }
   std::string current_key = GetCurrentSelectionKey();
-  if (cleaned_key != current_key && node.contains(cleaned_key)) {
+  if (cleaned_key != current_key && node.get_ref<const json::object_t&>().count(cleaned_key)) {
     editor_hint_ = "Error: This key is already in use.";
     rename_key_input_->TakeFocus();
     return;
   }
   ExecuteRenameKey(current_path_, current_key, cleaned_key);
   std::vector<std::string> path = current_path_;
-  history_manager_.Push({
-    [this, path, current_key, cleaned_key]() { ExecuteRenameKey(path, cleaned_key, current_key); },
-    [this, path, current_key, cleaned_key]() { ExecuteRenameKey(path, current_key, cleaned_key); },
-    path,
-    cleaned_key,
-  });
+  history_manager_.Record({.type = EditOpType::kRenameKey, .path = &path, .key = current_key, .other_key = cleaned_key, .flags = EditOp::kHasOtherKey});
   UpdateTreeEntries();
   int new_index = GetIndexFromEntries(cleaned_key);
   RefreshTreeAndCloseModal(new_index);
 }
 
 void JsonEditor::OnMoveUp() {
+  if (selection_count_ > 0) {
+    MoveSelection(-1);
+    return;
+  }
   std::string key = GetCurrentSelectionKey();
   if (key == "[None]" || key == "..") return;
 
   std::vector<std::string> path = current_path_;
   // 親が配列の場合、移動後のキー（インデックス）を計算してフォーカスを合わせる
   std::string next_focus_key = key;
-  json& parent = GetNode(input_json_, path);
+  std::optional<EditOp> op;
+  const json& parent = GetNode(path);
   if (parent.is_array()) {
     try {
       int index = std::stoul(key);
       if (index > 0) {
         next_focus_key = std::to_string(index - 1);
+        // 配列では位置で記録する。キー(インデックス)は移動すると別の要素を指すため
+        op = EditOp{.type = EditOpType::kMoveElement, .path = &path, .index = static_cast<uint64_t>(index), .other_index = static_cast<uint64_t>(index - 1)};
       }
     } catch (...) {}
+  } else {
+    op = EditOp{.type = EditOpType::kMoveKey, .path = &path, .key = key, .index = 0};
   }
 
   ExecuteMoveKey(path, key, -1);
-  history_manager_.Push({
-    [this, path, key]() { ExecuteMoveKey(path, key, 1); },
-    [this, path, key]() { ExecuteMoveKey(path, key, -1); },
-    path,
-    key
-  });
+  if (op) history_manager_.Record(*op);
 
   UpdateTreeEntries();
   int new_index = GetIndexFromEntries(next_focus_key);
@@ -647,29 +1047,32 @@ void JsonEditor::OnMoveUp() {
 }
 
 void JsonEditor::OnMoveDown() {
+  if (selection_count_ > 0) {
+    MoveSelection(1);
+    return;
+  }
   std::string key = GetCurrentSelectionKey();
   if (key == "[None]" || key == "..") return;
 
   std::vector<std::string> path = current_path_;
   // 親が配列の場合、移動後のキー（インデックス）を計算してフォーカスを合わせる
   std::string next_focus_key = key;
-  json& parent = GetNode(input_json_, path);
+  std::optional<EditOp> op;
+  const json& parent = GetNode(path);
   if (parent.is_array()) {
     try {
       int index = std::stoul(key);
       if (index < parent.size() - 1) {
         next_focus_key = std::to_string(index + 1);
+        op = EditOp{.type = EditOpType::kMoveElement, .path = &path, .index = static_cast<uint64_t>(index), .other_index = static_cast<uint64_t>(index + 1)};
       }
     } catch (...) {}
+  } else {
+    op = EditOp{.type = EditOpType::kMoveKey, .path = &path, .key = key, .index = 1};
   }
 
   ExecuteMoveKey(path, key, 1);
-  history_manager_.Push({
-    [this, path, key]() { ExecuteMoveKey(path, key, -1); },
-    [this, path, key]() { ExecuteMoveKey(path, key, 1); },
-    path,
-    key
-  });
+  if (op) history_manager_.Record(*op);
 
   UpdateTreeEntries();
   int new_index = GetIndexFromEntries(next_focus_key);
@@ -678,6 +1081,7 @@ void JsonEditor::OnMoveDown() {
 }
 
 void JsonEditor::ExecuteMoveKey(const std::vector<std::string>& path, const std::string& key, int direction) {
+  MarkModified(path);
   json& parent = GetNode(input_json_, path);
   if (parent.is_array()) {
     try {
@@ -689,138 +1093,1187 @@ void JsonEditor::ExecuteMoveKey(const std::vector<std::string>& path, const std:
       std::swap(parent[index], parent[new_index]);
     } catch (...) {}
   } else if (parent.is_object()) {
-    // オブジェクトの順序変更は、全要素をリスト化して位置を入れ替え、再構築する
-    std::vector<std::pair<std::string, json>> items;
-    int index = -1;
-    int current_idx = 0;
-
-    // 既存のペアをコピー
-    for (auto& [k, v] : parent.items()) {
-      if (k == key) index = current_idx;
-      items.push_back({k, v});
-      current_idx++;
+    // オブジェクトの順序変更は、要素をリスト上で付け替えるだけで行う
+    auto& object = parent.get_ref<json::object_t&>();
+    auto iter = object.find(key);
+    if (iter == object.end()) return;
+    if (direction < 0) {
+      if (iter == object.begin()) return;
+      object.MoveBefore(iter, std::prev(iter));
+    } else {
+      auto next = std::next(iter);
+      if (next == object.end()) return;
+      object.MoveBefore(iter, std::next(next));
     }
+  }
+}
 
-    if (index == -1) return;
-    int new_index = index + direction;
-    if (new_index < 0 || new_index >= items.size()) return;
-
-    // Swap
-    std::swap(items[index], items[new_index]);
+void JsonEditor::ExecuteMoveKeyBefore(const std::vector<std::string>& path, const std::string& key, const std::optional<std::string>& before_key) {
+  MarkModified(path);
+  json& node = GetNode(input_json_, path);
+  if (!node.is_object()) return;
+  auto& object = node.get_ref<json::object_t&>();
+  auto item = object.find(key);
+  if (item == object.end()) return;
+  object.MoveBefore(item, before_key ? object.find(*before_key) : object.end());
+}
 
-    // 再構築
-    parent.clear();
-    for (const auto& item : items) {
-      parent[item.first] = item.second;
-    }
-  }
+void JsonEditor::ExecuteMoveElement(const std::vector<std::string>& path, size_t from, size_t to) {
+  MarkModified(path);
+  json& node = GetNode(input_json_, path);
+  if (!node.is_array()) return;
+  // ギャップバッファ上で取り出して入れ直すため、ずれるのは間の要素だけ
+  auto& array = node.get_ref<json::array_t&>();
+  if (from >= array.size() || to >= array.size() || from == to) return;
+  json value = std::move(array[from]);
+  array.erase(array.begin() + from);
+  array.insert(array.begin() + to, std::move(value));
 }
 
-Component JsonEditor::BuildSearchModal() {
-  search_input_ = Input(&search_query_, "Search", InputOption{.on_enter = [this]{ OnSearchSubmit(); }});
-  search_input_ |= CatchEvent([this](Event event) {
+Component JsonEditor::BuildMoveModal() {
+  move_target_input_ = Input(&move_target_, "Index or key", InputOption{.on_enter = [this]{ OnMoveToSubmit(false); }});
+  move_target_input_ |= CatchEvent([this](Event event) {
     if (event == Event::Return) {
-      search_results_menu_->TakeFocus();
-      OnSearchSubmit();
+      OnMoveToSubmit(false);
       return true;
     }
     return false;
   });
-  search_from_root_checkbox_ = Checkbox("Search from root", &search_from_root_);
-  search_menu_option_.on_enter = [this] { OnSearchResultEnter(); };
-  search_results_menu_ = Menu(&search_result_labels_, &current_search_result_index_, search_menu_option_);
-  auto modal_layout = Container::Vertical({
-    search_input_,
-    search_from_root_checkbox_,
-    search_results_menu_,
+  auto close = [this] { modal_state_ = 0; tree_menu_->TakeFocus(); };
+  auto buttons = Container::Horizontal({
+    Button("Before", [this] { OnMoveToSubmit(false); }, GetModalButtonOption()),
+    Maybe(Button("After", [this] { OnMoveToSubmit(true); }, GetModalButtonOption()),
+          [this] { return GetNode(current_path_).is_object(); }),
+    Button("Cancel", close, GetModalButtonOption()),
   });
-  auto modal_renderer = Renderer(modal_layout, [this] {
+  auto modal = Container::Vertical({
+    move_target_input_,
+    buttons,
+  });
+  auto modal_renderer = Renderer(modal, [this, buttons] {
+    const bool is_array = GetNode(current_path_).is_array();
     return vbox({
-      text("Search") | center,
+      text("Move \"" + GetCurrentSelectionKey() + "\"") | center,
       separator(),
-      search_input_->Render(),
-      search_from_root_checkbox_->Render() | center,
+      move_target_input_->Render(),
+      text(is_array ? "Enter the destination index." : "Enter an index, or a key to move before/after.") | dim,
       separator(),
-      (search_result_labels_.empty()) ? text("No results") | center : search_results_menu_->Render() | vscroll_indicator | frame | size(HEIGHT, LESS_THAN, 10),
-    }) | border | size(WIDTH, GREATER_THAN, 40);
+      buttons->Render() | center,
+    }) | border;
   });
   return ApplyModalBehavors(modal_renderer);
 }
 
-bool JsonEditor::OnOpenSearchModal() {
-  search_query_ = "";
-  search_result_labels_.clear();
-  search_results_.clear();
-  modal_state_ = 4;
-  search_input_->TakeFocus();
+bool JsonEditor::OnOpenMoveModal() {
+  std::string key = GetCurrentSelectionKey();
+  if (key == "[None]" || key == ".." || GetNode(current_path_).size() < 2) {
+    editor_hint_ = "Error: Cannot move this item.";
+    return false;
+  }
+  move_target_ = "";
+  modal_state_ = 8;
+  move_target_input_->TakeFocus();
   return true;
 }
 
-void JsonEditor::OnSearchSubmit() {
-  if (search_query_.empty()) {
+void JsonEditor::OnMoveToSubmit(bool after) {
+  const std::string key = GetCurrentSelectionKey();
+  const json& node = GetNode(current_path_);
+  if (key == "[None]" || key == ".." || !node.is_structured()) {
+    RefreshTreeAndCloseModal(selected_tree_item_index_);
     return;
   }
-  search_results_.clear();
-  search_result_labels_.clear();
-  current_search_result_index_ = 0;
-  // 再帰検索ロジック
-  std::function<void(const json&, std::vector<std::string>)> search_recursive = [&](const json& node, std::vector<std::string> path) {
-    auto get_path_string = [](const std::vector<std::string>& p) {
-      std::string s = "";
-      for (size_t i = 0; i < p.size(); ++i) {
-        s += p[i];
-        if (i < p.size() - 1) s += " > ";
-      }
-      return s;
-    };
-    if (node.is_object()) {
-      for (auto& [key, val] : node.items()) {
-        std::vector<std::string> current_path = path;
-        current_path.push_back(key);
-        // キーの部分一致
-        if (key.find(search_query_) != std::string::npos) {
-          search_results_.push_back(current_path);
-          search_result_labels_.push_back("Key: " + key + " (Path: " + get_path_string(current_path) + ")");
-        }
-        // 値(文字列)の部分一致
-        if (val.is_string() && val.get<std::string>().find(search_query_) != std::string::npos) {
-          search_results_.push_back(current_path);
-          search_result_labels_.push_back("Val: " + val.get<std::string>() + " (Path: " + get_path_string(current_path) + ")");
-        }
-        search_recursive(val, current_path);
+  const std::string target = CleanStringForJson(move_target_);
+  const size_t size = node.size();
+  const size_t from = entries_[selected_tree_item_index_].position;
+  // 数字だけの入力は位置として扱う。ただし同名のキーがあればキーを優先する
+  const bool is_index = !target.empty()
+    && std::all_of(target.begin(), target.end(), [](unsigned char c) { return std::isdigit(c); })
+    && !(node.is_object() && node.get_ref<const json::object_t&>().count(target));
+  size_t to = size - 1;
+  if (is_index) {
+    try {
+      to = std::min<size_t>(std::stoull(target), size - 1);
+    } catch (...) {}
+  }
+  std::vector<std::string> path = current_path_;
+  std::string focus_key = key;
+  if (node.is_array()) {
+    if (!is_index) {
+      editor_hint_ = "Error: Enter an index.";
+      move_target_input_->TakeFocus();
+      return;
+    }
+    if (to == from) {
+      RefreshTreeAndCloseModal(selected_tree_item_index_);
+      return;
+    }
+    ExecuteMoveElement(path, from, to);
+    history_manager_.Record({.type = EditOpType::kMoveElement, .path = &path, .index = from, .other_index = to});
+    focus_key = std::to_string(to);
+  } else {
+    // オブジェクトでは移動先を「どのキーの直前か」で表し、Undoも同じ形で記録する
+    const auto& object = node.get_ref<const json::object_t&>();
+    auto item = object.find(key);
+    if (item == object.end()) {
+      RefreshTreeAndCloseModal(selected_tree_item_index_);
+      return;
+    }
+    std::optional<std::string> old_next;
+    if (std::next(item) != object.end()) old_next = std::next(item)->first;
+    std::optional<std::string> new_next;
+    if (is_index) {
+      // 下へ動かすときは、移動後にto番目となるようその次の要素の前へ置く
+      const size_t before = to < from ? to : to + 1;
+      if (before < size) new_next = std::next(object.begin(), before)->first;
+    } else {
+      auto anchor = object.find(target);
+      if (anchor == object.end()) {
+        editor_hint_ = "Error: Key not found.";
+        move_target_input_->TakeFocus();
+        return;
       }
-    } else if (node.is_array()) {
-      for (size_t i = 0; i < node.size(); ++i) {
-        std::vector<std::string> current_path = path;
-        current_path.push_back(std::to_string(i));
-        // 値(文字列)の部分一致
-        if (node[i].is_string() && node[i].get<std::string>().find(search_query_) != std::string::npos) {
-          search_results_.push_back(current_path);
-          search_result_labels_.push_back("Val: " + node[i].get<std::string>() + " (Path: " + get_path_string(current_path) + ")");
-        }
-        search_recursive(node[i], current_path);
+      if (!after) {
+        new_next = target;
+      } else {
+        auto next = std::next(anchor);
+        if (next == item) ++next;
+        if (next != object.end()) new_next = next->first;
       }
     }
-  };
-
-  if (search_from_root_) {
-    search_recursive(input_json_, {});
-  } else {
-    json& current_node = GetNode(input_json_, current_path_);
-    search_recursive(current_node, current_path_);
-  }
-  if (search_results_.empty()) {
-    search_result_labels_.push_back("No results found.");
-    search_input_->TakeFocus();
-  } else {
-    search_results_menu_->TakeFocus();
+    if (new_next == old_next || new_next == key) {
+      RefreshTreeAndCloseModal(selected_tree_item_index_);
+      return;
+    }
+    ExecuteMoveKeyBefore(path, key, new_next);
+    EditOp op{.type = EditOpType::kMoveKeyBefore, .path = &path, .key = key};
+    if (new_next) {
+      op.other_key = *new_next;
+      op.flags |= EditOp::kHasOtherKey;
+    }
+    if (old_next) {
+      op.undo_key = *old_next;
+      op.flags |= EditOp::kHasUndoKey;
+    }
+    history_manager_.Record(op);
   }
+  ClearSelection();
+  UpdateTreeEntries();
+  RefreshTreeAndCloseModal(GetIndexFromEntries(focus_key));
 }
 
-void JsonEditor::OnSearchResultEnter() {
-  if (search_results_.empty() || current_search_result_index_ < 0 || current_search_result_index_ >= search_results_.size()) {
-    return;
-  }
+bool JsonEditor::ToggleSelection() {
+  if (entries_.empty() || selected_tree_item_index_ < 0 || selected_tree_item_index_ >= entries_.size()) return false;
+  const TreeEntry& entry = entries_[selected_tree_item_index_];
+  if (entry.key == ".." || entry.position >= selection_.size()) return false;
+  const bool selected = !selection_[entry.position];
+  selection_[entry.position] = selected;
+  if (selected) ++selection_count_;
+  else --selection_count_;
+  selection_anchor_ = entry.position;
+  return true;
+}
+
+bool JsonEditor::SelectRange() {
+  if (entries_.empty() || selected_tree_item_index_ < 0 || selected_tree_item_index_ >= entries_.size()) return false;
+  const TreeEntry& current = entries_[selected_tree_item_index_];
+  if (current.key == "..") return false;
+  const size_t first = std::min(selection_anchor_, current.position);
+  const size_t last = std::max(selection_anchor_, current.position);
+  // フィルタ中は表示されている項目だけを選ぶ
+  for (const auto& entry : entries_) {
+    if (entry.key == ".." || entry.position < first || last < entry.position) continue;
+    if (!selection_[entry.position]) {
+      selection_[entry.position] = true;
+      ++selection_count_;
+    }
+  }
+  return true;
+}
+
+void JsonEditor::ClearSelection() {
+  selection_.assign(selection_.size(), false);
+  selection_count_ = 0;
+}
+
+std::vector<size_t> JsonEditor::GetTargetPositions() const {
+  std::vector<size_t> positions;
+  if (selection_count_ > 0) {
+    positions.reserve(selection_count_);
+    for (size_t i = 0; i < selection_.size(); ++i) {
+      if (selection_[i]) positions.push_back(i);
+    }
+  } else if (0 <= selected_tree_item_index_ && selected_tree_item_index_ < entries_.size()
+             && entries_[selected_tree_item_index_].key != "..") {
+    positions.push_back(entries_[selected_tree_item_index_].position);
+  }
+  return positions;
+}
+
+void JsonEditor::MoveSelection(int direction) {
+  // 選択された項目を、隣の選択されていない項目と入れ替えていく
+  // 端に詰まった連続選択は動かさず、それ以外は1つずつ移動する
+  std::vector<size_t> swaps;
+  const size_t count = selection_.size();
+  if (direction < 0) {
+    for (size_t i = 1; i < count; ++i) {
+      if (selection_[i] && !selection_[i - 1]) {
+        selection_[i - 1] = true;
+        selection_[i] = false;
+        swaps.push_back(i - 1);
+      }
+    }
+  } else {
+    for (size_t i = count; i-- > 1;) {
+      if (selection_[i - 1] && !selection_[i]) {
+        selection_[i] = true;
+        selection_[i - 1] = false;
+        swaps.push_back(i - 1);
+      }
+    }
+  }
+  if (swaps.empty()) return;
+  std::vector<std::string> path = current_path_;
+  ExecuteSwapEntries(path, swaps, false);
+  // カーソル位置の項目を追いかける
+  const bool is_array = GetNode(path).is_array();
+  std::string focus_key = GetCurrentSelectionKey();
+  if (is_array && 0 <= selected_tree_item_index_ && selected_tree_item_index_ < entries_.size()) {
+    size_t position = entries_[selected_tree_item_index_].position;
+    for (size_t swap : swaps) {
+      if (position == swap) position = swap + 1;
+      else if (position == swap + 1) position = swap;
+    }
+    focus_key = std::to_string(position);
+  }
+  history_manager_.Push({
+    [this, path, swaps]() { ExecuteSwapEntries(path, swaps, true); },
+    [this, path, swaps]() { ExecuteSwapEntries(path, swaps, false); },
+    path,
+    focus_key,
+    swaps.capacity() * sizeof(size_t),
+  });
+  UpdateTreeEntries();
+  int new_index = GetIndexFromEntries(focus_key);
+  if (new_index >= 0) selected_tree_item_index_ = new_index;
+  UpdateEditorPane();
+}
+
+void JsonEditor::OnDuplicate() {
+  std::vector<size_t> positions = GetTargetPositions();
+  const json& node = GetNode(current_path_);
+  if (positions.empty() || !node.is_structured()) {
+    editor_hint_ = "Error: Cannot duplicate this item.";
+    return;
+  }
+  // 複製はそれぞれの元の直後に置く。位置は挿入後の位置で記録する
+  auto copies = std::make_shared<std::vector<BulkRecord>>();
+  std::vector<size_t> copy_positions;
+  copies->reserve(positions.size());
+  copy_positions.reserve(positions.size());
+  if (node.is_object()) {
+    const auto& object = node.get_ref<const json::object_t&>();
+    std::unordered_set<std::string> new_keys;
+    auto iter = object.begin();
+    size_t position = 0;
+    for (size_t target : positions) {
+      std::advance(iter, target - position);
+      position = target;
+      std::string key = MakeUniqueKey(object, iter->first, new_keys);
+      new_keys.insert(key);
+      copy_positions.push_back(target + copies->size() + 1);
+      copies->push_back({copy_positions.back(), std::move(key), iter->second});
+    }
+  } else {
+    const auto& array = node.get_ref<const json::array_t&>();
+    for (size_t target : positions) {
+      copy_positions.push_back(target + copies->size() + 1);
+      copies->push_back({copy_positions.back(), "", array[target]});
+    }
+  }
+  std::vector<std::string> path = current_path_;
+  const std::string focus_key = node.is_object() ? copies->front().key : std::to_string(copy_positions.front());
+  ExecuteInsertEntries(path, *copies);
+  history_manager_.Push({
+    [this, path, copy_positions, copies]() { *copies = ExecuteRemoveEntries(path, copy_positions); },
+    [this, path, copies]() { ExecuteInsertEntries(path, *copies); },
+    path,
+    focus_key,
+    EstimateRecordBytes(*copies) + copy_positions.capacity() * sizeof(size_t),
+  });
+  UpdateTreeEntries();
+  RefreshTreeAndCloseModal(GetIndexFromEntries(focus_key));
+  editor_hint_ = "Duplicated " + std::to_string(copy_positions.size()) + " item(s).";
+}
+
+std::shared_ptr<std::vector<BulkRecord>> JsonEditor::DeleteEntries(const std::vector<size_t>& positions) {
+  // 1回の走査でまとめて取り除き、1つの履歴にする
+  std::vector<std::string> path = current_path_;
+  auto deleted = std::make_shared<std::vector<BulkRecord>>(ExecuteRemoveEntries(path, positions));
+  if (deleted->empty()) {
+    RefreshTreeAndCloseModal(selected_tree_item_index_);
+    return deleted;
+  }
+  const bool is_object = GetNode(path).is_object();
+  history_manager_.Push({
+    [this, path, deleted]() { ExecuteInsertEntries(path, *deleted); },
+    [this, path, positions, deleted]() { *deleted = ExecuteRemoveEntries(path, positions); },
+    path,
+    is_object ? deleted->front().key : std::to_string(positions.front()),
+    EstimateRecordBytes(*deleted) + positions.capacity() * sizeof(size_t),
+  });
+  UpdateTreeEntries();
+  RefreshTreeAndCloseModal(GetIndexFromPosition(positions.front()));
+  return deleted;
+}
+
+std::string JsonEditor::MakeUniqueKey(const json::object_t& object, const std::string& key, const std::unordered_set<std::string>& reserved) const {
+  if (!object.count(key) && !reserved.count(key)) return key;
+  const std::string base = key + "_copy";
+  std::string unique = base;
+  for (int suffix = 2; object.count(unique) || reserved.count(unique); ++suffix) {
+    unique = base + std::to_string(suffix);
+  }
+  return unique;
+}
+
+void JsonEditor::OnYank() {
+  std::vector<size_t> positions = GetTargetPositions();
+  const json& node = GetNode(current_path_);
+  if (positions.empty() || !node.is_structured()) {
+    editor_hint_ = "Error: Cannot yank this item.";
+    return;
+  }
+  // コピーはコンテナを共有するため、大きなサブツリーでも要素数に比例しない
+  std::vector<BulkRecord> records;
+  records.reserve(positions.size());
+  if (node.is_object()) {
+    auto iter = node.get_ref<const json::object_t&>().begin();
+    size_t position = 0;
+    for (size_t target : positions) {
+      std::advance(iter, target - position);
+      position = target;
+      records.push_back({target, iter->first, iter->second});
+    }
+  } else {
+    const auto& array = node.get_ref<const json::array_t&>();
+    for (size_t target : positions) {
+      records.push_back({target, std::to_string(target), array[target]});
+    }
+  }
+  SetClipboard(std::move(records));
+  editor_hint_ = "Yanked " + std::to_string(clipboard_.size()) + " item(s).";
+}
+
+void JsonEditor::OnCut() {
+  std::vector<size_t> positions = GetTargetPositions();
+  if (positions.empty() || !GetNode(current_path_).is_structured()) {
+    editor_hint_ = "Error: Cannot cut this item.";
+    return;
+  }
+  const bool is_object = GetNode(current_path_).is_object();
+  auto deleted = DeleteEntries(positions);
+  if (deleted->empty()) {
+    editor_hint_ = "Error: Cannot cut this item.";
+    return;
+  }
+  // 削除した値は履歴とクリップボードで共有する
+  std::vector<BulkRecord> records = *deleted;
+  if (!is_object) {
+    for (auto& record : records) {
+      record.key = std::to_string(record.position);
+    }
+  }
+  SetClipboard(std::move(records));
+  editor_hint_ = "Cut " + std::to_string(clipboard_.size()) + " item(s).";
+}
+
+void JsonEditor::OnPaste() {
+  const json& node = GetNode(current_path_);
+  if (clipboard_.empty() || !node.is_structured()) {
+    editor_hint_ = "Error: Nothing to paste.";
+    return;
+  }
+  // カーソル位置の直後へ、クリップボードの順に連続して挿入する
+  size_t insert_position = 0;
+  if (selected_tree_item_index_ >= 0 && selected_tree_item_index_ < entries_.size()) {
+    const TreeEntry& entry = entries_[selected_tree_item_index_];
+    if (entry.key != "..") insert_position = entry.position + 1;
+  }
+  auto pasted = std::make_shared<std::vector<BulkRecord>>();
+  std::vector<size_t> positions;
+  pasted->reserve(clipboard_.size());
+  positions.reserve(clipboard_.size());
+  if (node.is_object()) {
+    const auto& object = node.get_ref<const json::object_t&>();
+    std::unordered_set<std::string> new_keys;
+    for (const auto& record : clipboard_) {
+      std::string key = MakeUniqueKey(object, record.key.empty() ? std::to_string(record.position) : record.key, new_keys);
+      new_keys.insert(key);
+      positions.push_back(insert_position + pasted->size());
+      pasted->push_back({positions.back(), std::move(key), record.value});
+    }
+  } else {
+    for (const auto& record : clipboard_) {
+      positions.push_back(insert_position + pasted->size());
+      pasted->push_back({positions.back(), "", record.value});
+    }
+  }
+  std::vector<std::string> path = current_path_;
+  const std::string focus_key = node.is_object() ? pasted->front().key : std::to_string(insert_position);
+  ExecuteInsertEntries(path, *pasted);
+  history_manager_.Push({
+    [this, path, positions, pasted]() { *pasted = ExecuteRemoveEntries(path, positions); },
+    [this, path, pasted]() { ExecuteInsertEntries(path, *pasted); },
+    path,
+    focus_key,
+    EstimateRecordBytes(*pasted) + positions.capacity() * sizeof(size_t),
+  });
+  UpdateTreeEntries();
+  RefreshTreeAndCloseModal(GetIndexFromEntries(focus_key));
+  editor_hint_ = "Pasted " + std::to_string(positions.size()) + " item(s).";
+}
+
+void JsonEditor::SetClipboard(std::vector<BulkRecord> records) {
+  for (auto& record : clipboard_) {
+    ReleaseJson(record.value);
+  }
+  clipboard_ = std::move(records);
+}
+
+Component JsonEditor::BuildConvertModal() {
+  auto close = [this] { modal_state_ = 0; tree_menu_->TakeFocus(); };
+  auto buttons = Container::Horizontal({
+    Button("String", [this] { OnConvertSubmit(json::value_t::string); }, GetModalButtonOption()),
+    Button("Number", [this] { OnConvertSubmit(json::value_t::number_integer); }, GetModalButtonOption()),
+    Button("Boolean", [this] { OnConvertSubmit(json::value_t::boolean); }, GetModalButtonOption()),
+    Button("Null", [this] { OnConvertSubmit(json::value_t::null); }, GetModalButtonOption()),
+    Button("Cancel", close, GetModalButtonOption()),
+  });
+  auto modal_renderer = Renderer(buttons, [this, buttons] {
+    const size_t count = selection_count_ > 0 ? selection_count_ : 1;
+    return vbox({
+      text("Convert Type") | center,
+      separator(),
+      text("Items: " + std::to_string(count)) | center,
+      text("Objects and arrays are left unchanged.") | center | dim,
+      separator(),
+      buttons->Render() | center,
+    }) | border;
+  });
+  return ApplyModalBehavors(modal_renderer);
+}
+
+bool JsonEditor::OnOpenConvertModal() {
+  if (GetTargetPositions().empty()) {
+    editor_hint_ = "Error: Cannot convert this item.";
+    return false;
+  }
+  modal_state_ = 6;
+  return true;
+}
+
+void JsonEditor::OnConvertSubmit(json::value_t type) {
+  std::vector<size_t> positions = GetTargetPositions();
+  const json& node = GetNode(current_path_);
+  // 変換後の値を記録に作り、ドキュメントとまとめて入れ替える
+  auto converted = std::make_shared<std::vector<BulkRecord>>();
+  auto convert = [&](size_t position, const std::string& key, const json& value) {
+    json out;
+    if (ConvertValue(value, type, out) && out != value) {
+      converted->push_back({position, key, std::move(out)});
+    }
+  };
+  if (node.is_object()) {
+    auto iter = node.get_ref<const json::object_t&>().begin();
+    size_t position = 0;
+    for (size_t target : positions) {
+      std::advance(iter, target - position);
+      position = target;
+      convert(target, iter->first, iter->second);
+    }
+  } else if (node.is_array()) {
+    const auto& array = node.get_ref<const json::array_t&>();
+    for (size_t target : positions) {
+      convert(target, "", array[target]);
+    }
+  }
+  if (converted->empty()) {
+    RefreshTreeAndCloseModal(selected_tree_item_index_);
+    editor_hint_ = "Nothing to convert.";
+    return;
+  }
+  std::vector<std::string> path = current_path_;
+  ExecuteSwapValues(path, *converted);
+  auto swap_values = [this, path, converted]() { ExecuteSwapValues(path, *converted); };
+  history_manager_.Push({
+    swap_values,
+    swap_values,
+    path,
+    GetCurrentSelectionKey(),
+    EstimateRecordBytes(*converted),
+  });
+  RefreshTreeAndCloseModal(selected_tree_item_index_);
+  editor_hint_ = "Converted " + std::to_string(converted->size()) + " value(s).";
+}
+
+Component JsonEditor::BuildSortModal() {
+  sort_key_input_ = Input(&sort_key_, "Sub-key (empty: by value)", InputOption{.on_enter = [this]{ OnSortSubmit(false); }});
+  sort_key_input_ |= CatchEvent([this](Event event) {
+    if (event == Event::Return) {
+      OnSortSubmit(false);
+      return true;
+    }
+    return false;
+  });
+  auto close = [this] { modal_state_ = 0; tree_menu_->TakeFocus(); };
+  auto buttons = Container::Horizontal({
+    Button("Ascending", [this] { OnSortSubmit(false); }, GetModalButtonOption()),
+    Button("Descending", [this] { OnSortSubmit(true); }, GetModalButtonOption()),
+    Button("Cancel", close, GetModalButtonOption()),
+  });
+  auto modal = Container::Vertical({
+    Maybe(sort_key_input_, [this] { return GetNode(current_path_).is_array(); }),
+    buttons,
+  });
+  auto modal_renderer = Renderer(modal, [this, buttons] {
+    const json& node = GetNode(current_path_);
+    Element option = node.is_array()
+      ? sort_key_input_->Render()
+      : text("Keys are sorted by name.") | center | dim;
+    return vbox({
+      text(node.is_array() ? "Sort Array" : "Sort Keys") | center,
+      separator(),
+      option,
+      separator(),
+      buttons->Render() | center,
+    }) | border;
+  });
+  return ApplyModalBehavors(modal_renderer);
+}
+
+bool JsonEditor::OnOpenSortModal() {
+  const json& node = GetNode(current_path_);
+  if (!node.is_structured() || node.size() < 2) {
+    editor_hint_ = "Error: Nothing to sort.";
+    return false;
+  }
+  modal_state_ = 7;
+  if (node.is_array()) sort_key_input_->TakeFocus();
+  return true;
+}
+
+void JsonEditor::OnSortSubmit(bool descending) {
+  const json& node = GetNode(current_path_);
+  if (!node.is_structured() || node.size() > std::numeric_limits<uint32_t>::max()) {
+    editor_hint_ = "Error: Cannot sort this item.";
+    RefreshTreeAndCloseModal(selected_tree_item_index_);
+    return;
+  }
+  // 要素ではなく位置の列をソートし、その列を並べ替えとUndoの両方に使う
+  std::vector<uint32_t> order(node.size());
+  std::iota(order.begin(), order.end(), 0);
+  if (node.is_object()) {
+    std::vector<const std::string*> keys;
+    keys.reserve(order.size());
+    for (const auto& [key, value] : node.get_ref<const json::object_t&>()) {
+      keys.push_back(&key);
+    }
+    ParallelStableSort(order, [&](uint32_t lhs, uint32_t rhs) {
+      return descending ? *keys[rhs] < *keys[lhs] : *keys[lhs] < *keys[rhs];
+    });
+  } else {
+    // 比べる値を先に引いておく。サブキーを持たない要素は末尾に集める
+    const std::string sub_key = CleanStringForJson(sort_key_);
+    std::vector<const json*> values;
+    values.reserve(order.size());
+    for (const json& element : node.get_ref<const json::array_t&>()) {
+      values.push_back(sub_key.empty() ? &element : FindChild(element, sub_key));
+    }
+    ParallelStableSort(order, [&](uint32_t lhs, uint32_t rhs) {
+      const json* left = values[lhs];
+      const json* right = values[rhs];
+      if (!left || !right) return left && !right;
+      return descending ? *right < *left : *left < *right;
+    });
+  }
+  if (std::is_sorted(order.begin(), order.end())) {
+    RefreshTreeAndCloseModal(selected_tree_item_index_);
+    editor_hint_ = "Already sorted.";
+    return;
+  }
+  // カーソル位置の項目を並べ替え後も追う
+  std::string focus_key = node.is_object() ? GetCurrentSelectionKey() : "0";
+  if (node.is_array() && 0 <= selected_tree_item_index_ && selected_tree_item_index_ < entries_.size()
+      && entries_[selected_tree_item_index_].key != "..") {
+    const size_t position = entries_[selected_tree_item_index_].position;
+    focus_key = std::to_string(std::find(order.begin(), order.end(), position) - order.begin());
+  }
+  std::vector<std::string> path = current_path_;
+  auto shared_order = std::make_shared<std::vector<uint32_t>>(std::move(order));
+  ExecutePermuteEntries(path, *shared_order, false);
+  history_manager_.Push({
+    [this, path, shared_order]() { ExecutePermuteEntries(path, *shared_order, true); },
+    [this, path, shared_order]() { ExecutePermuteEntries(path, *shared_order, false); },
+    path,
+    focus_key,
+    shared_order->capacity() * sizeof(uint32_t),
+  });
+  ClearSelection();
+  UpdateTreeEntries();
+  RefreshTreeAndCloseModal(GetIndexFromEntries(focus_key));
+  editor_hint_ = "Sorted " + std::to_string(shared_order->size()) + " item(s).";
+}
+
+void JsonEditor::OnDedupe() {
+  const json& node = GetNode(current_path_);
+  if (!node.is_array() || node.size() > std::numeric_limits<uint32_t>::max()) {
+    editor_hint_ = "Error: Can only dedupe arrays.";
+    return;
+  }
+  // 履歴には位置だけを残し、取り除いた値は持たない
+  auto removed = std::make_shared<std::vector<uint32_t>>();
+  auto sources = std::make_shared<std::vector<uint32_t>>();
+  FindDuplicates(node.get_ref<const json::array_t&>(), *removed, *sources);
+  if (removed->empty()) {
+    editor_hint_ = "No duplicates found.";
+    return;
+  }
+  std::vector<std::string> path = current_path_;
+  ExecuteRemoveDuplicates(path, *removed);
+  history_manager_.Push({
+    [this, path, removed, sources]() { ExecuteRestoreDuplicates(path, *removed, *sources); },
+    [this, path, removed]() { ExecuteRemoveDuplicates(path, *removed); },
+    path,
+    GetCurrentSelectionKey(),
+    (removed->capacity() + sources->capacity()) * sizeof(uint32_t),
+  });
+  ClearSelection();
+  RefreshTreeAndCloseModal(selected_tree_item_index_);
+  editor_hint_ = "Removed " + std::to_string(removed->size()) + " duplicate(s).";
+}
+
+void JsonEditor::FindDuplicates(const json::array_t& array, std::vector<uint32_t>& removed, std::vector<uint32_t>& sources) const {
+  const size_t count = array.size();
+  const size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+  const size_t chunk_count = std::clamp<size_t>(count / 4096, 1, thread_count);
+  // ハッシュ値と位置の組を並べ、参照先を辿らずに比べられるようにする
+  std::vector<std::pair<size_t, uint32_t>> hashed(count);
+  RunParallel(chunk_count, [&](size_t chunk) {
+    for (size_t i = count * chunk / chunk_count; i < count * (chunk + 1) / chunk_count; ++i) {
+      hashed[i] = {HashJson(array[i]), static_cast<uint32_t>(i)};
+    }
+  });
+  // ハッシュ値で安定ソートすると、同じハッシュ値の要素が元の順に並ぶ
+  ParallelStableSort(hashed, [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+  // 同じハッシュ値の並びを分けないように区間を切り、区間ごとに並列で比べる
+  std::vector<size_t> bounds{0};
+  for (size_t chunk = 1; chunk < chunk_count; ++chunk) {
+    size_t bound = std::max(bounds.back(), count * chunk / chunk_count);
+    while (bound > 0 && bound < count && hashed[bound].first == hashed[bound - 1].first) ++bound;
+    bounds.push_back(bound);
+  }
+  bounds.push_back(count);
+  // 各要素と同一の最初の要素の位置。重複していなければ自身の位置
+  std::vector<uint32_t> firsts(count);
+  RunParallel(chunk_count, [&](size_t chunk) {
+    std::vector<uint32_t> distinct;
+    for (size_t begin = bounds[chunk]; begin < bounds[chunk + 1];) {
+      size_t end = begin + 1;
+      while (end < bounds[chunk + 1] && hashed[end].first == hashed[begin].first) ++end;
+      // ハッシュ値が衝突しただけの要素や、1と1.0のように表現の違う要素は別の値として残す
+      distinct.clear();
+      for (size_t i = begin; i < end; ++i) {
+        const uint32_t index = hashed[i].second;
+        auto found = std::find_if(distinct.begin(), distinct.end(), [&](uint32_t kept) { return IdenticalJson(array[kept], array[index]); });
+        if (found == distinct.end()) {
+          distinct.push_back(index);
+          firsts[index] = index;
+        } else {
+          firsts[index] = *found;
+        }
+      }
+      begin = end;
+    }
+  });
+  for (uint32_t i = 0; i < count; ++i) {
+    if (firsts[i] == i) continue;
+    removed.push_back(i);
+    sources.push_back(firsts[i]);
+  }
+}
+
+bool JsonEditor::ConvertValue(const json& value, json::value_t type, json& out) const {
+  if (value.is_structured()) return false;
+  switch (type) {
+    case json::value_t::string:
+      out = value.is_string() ? value : json(value.dump());
+      return true;
+    case json::value_t::number_integer:
+    case json::value_t::number_unsigned:
+    case json::value_t::number_float:
+      if (value.is_number()) out = value;
+      else if (value.is_boolean()) out = value.get<bool>() ? 1 : 0;
+      else if (value.is_null()) out = 0;
+      else {
+        json parsed = json::parse(value.get_ref<const std::string&>(), nullptr, false);
+        if (!parsed.is_number()) return false;
+        out = std::move(parsed);
+      }
+      return true;
+    case json::value_t::boolean:
+      if (value.is_boolean()) out = value;
+      else if (value.is_number()) out = value.get<double>() != 0;
+      else if (value.is_null()) out = false;
+      else if (value == "true" || value == "false") out = (value == "true");
+      else return false;
+      return true;
+    case json::value_t::null:
+      out = nullptr;
+      return true;
+    default:
+      return false;
+  }
+}
+
+Component JsonEditor::BuildSearchModal() {
+  search_input_ = Input(&search_query_, "Search", InputOption{.on_enter = [this]{ OnSearchSubmit(); }});
+  search_input_ |= CatchEvent([this](Event event) {
+    if (event == Event::Return) {
+      search_results_menu_->TakeFocus();
+      OnSearchSubmit();
+      return true;
+    }
+    return false;
+  });
+  search_from_root_checkbox_ = Checkbox("Search from root", &search_from_root_);
+  replace_input_ = Input(&replace_text_, "Replace with", InputOption{.on_enter = [this]{ OnReplaceSubmit(); }});
+  replace_input_ |= CatchEvent([this](Event event) {
+    if (event == Event::Return) {
+      OnReplaceSubmit();
+      return true;
+    }
+    return false;
+  });
+  replace_button_ = Button("Replace All", [this] { OnReplaceSubmit(); }, GetModalButtonOption());
+  filter_button_ = Button("Filter Tree", [this] { OnFilterSubmit(); }, GetModalButtonOption());
+  search_menu_option_.on_enter = [this] { OnSearchResultEnter(); };
+  search_results_menu_ = Menu(&search_result_labels_, &current_search_result_index_, search_menu_option_);
+  auto modal_layout = Container::Vertical({
+    search_input_,
+    search_from_root_checkbox_,
+    Container::Horizontal({
+      replace_input_,
+      replace_button_,
+      filter_button_,
+    }),
+    search_results_menu_,
+  });
+  auto modal_renderer = Renderer(modal_layout, [this] {
+    return vbox({
+      text("Search") | center,
+      separator(),
+      search_input_->Render(),
+      search_from_root_checkbox_->Render() | center,
+      hbox({
+        replace_input_->Render() | flex,
+        replace_button_->Render(),
+        filter_button_->Render(),
+      }),
+      separator(),
+      (search_result_labels_.empty()) ? text("No results") | center : search_results_menu_->Render() | vscroll_indicator | frame | size(HEIGHT, LESS_THAN, 10),
+    }) | border | size(WIDTH, GREATER_THAN, 40);
+  });
+  return ApplyModalBehavors(modal_renderer);
+}
+
+bool JsonEditor::OnOpenSearchModal() {
+  search_query_ = "";
+  replace_text_ = "";
+  search_result_labels_.clear();
+  search_results_.clear();
+  modal_state_ = 4;
+  search_input_->TakeFocus();
+  return true;
+}
+
+void JsonEditor::OnSearchSubmit() {
+  if (search_query_.empty()) {
+    return;
+  }
+  search_results_.clear();
+  search_result_labels_.clear();
+  current_search_result_index_ = 0;
+  std::vector<std::string> scope;
+  if (!search_from_root_) scope = current_path_;
+  const SearchCacheEntry& entry = GetSearchResults(search_query_, scope);
+  for (const auto& partition : entry.partitions) {
+    for (const auto& hit : partition.hits) {
+      search_results_.push_back(hit.path);
+      search_result_labels_.push_back(hit.label);
+    }
+  }
+  if (search_results_.empty()) {
+    search_result_labels_.push_back("No results found.");
+    search_input_->TakeFocus();
+  } else {
+    search_results_menu_->TakeFocus();
+  }
+}
+
+const SearchCacheEntry& JsonEditor::GetSearchResults(const std::string& query, const std::vector<std::string>& scope, TreeFilter* filter) {
+  SearchCacheEntry* cached = search_cache_.Find(query, scope);
+  const uint64_t version = document_version_.Current();
+  if (!filter && cached && cached->version == version) {
+    return *cached;
+  }
+  // 範囲直下の子ごとに、変更のないものは前回の結果を再利用する
+  // フィルタを作るときはノードIDを割り当てるため全体を走査する
+  SearchCacheEntry entry{query, scope, version, {}};
+  const json& root = GetNode(scope);
+  uint32_t first_child = 0;
+  if (filter) {
+    filter->Reset();
+    if (root.is_structured()) first_child = filter->Push(0, root.size());
+  }
+  std::vector<std::string> path = scope;
+  size_t index = 0;
+  auto visit_child = [&](const std::string& key, const json& child) {
+    path.push_back(key);
+    if (!filter && cached && index < cached->partitions.size()
+        && cached->partitions[index].key == path.back()
+        && document_version_.SubtreeVersion(path) <= cached->version) {
+      entry.partitions.push_back(std::move(cached->partitions[index]));
+    } else {
+      SearchPartition partition{path.back(), {}};
+      CollectSearchHits(query, child, root.is_object(), path, partition.hits, filter, first_child + static_cast<uint32_t>(index));
+      entry.partitions.push_back(std::move(partition));
+    }
+    path.pop_back();
+    ++index;
+  };
+  if (root.is_object()) {
+    for (const auto& [key, child] : root.get_ref<const json::object_t&>()) {
+      visit_child(key, child);
+    }
+  } else if (root.is_array()) {
+    for (const json& child : root.get_ref<const json::array_t&>()) {
+      visit_child(std::to_string(index), child);
+    }
+  }
+  if (filter && root.is_structured()) {
+    filter->Pop();
+  }
+  return search_cache_.Store(std::move(entry));
+}
+
+void JsonEditor::CollectSearchHits(const std::string& query, const json& node, bool match_key, std::vector<std::string>& path, std::vector<SearchHit>& hits, TreeFilter* filter, uint32_t node_id) const {
+  // pathの末尾がvalのキー/インデックスを指している状態で呼ぶ
+  auto visit = [&](const json& val, bool is_key, uint32_t id) {
+    // キーの部分一致
+    if (is_key && path.back().find(query) != std::string::npos) {
+      hits.push_back({path, "Key: " + path.back() + " (Path: " + JoinPath(path) + ")"});
+      if (filter) filter->MarkHit(id);
+    }
+    // 値(文字列)の部分一致
+    if (val.is_string() && val.get_ref<const std::string&>().find(query) != std::string::npos) {
+      hits.push_back({path, "Val: " + val.get_ref<const std::string&>() + " (Path: " + JoinPath(path) + ")"});
+      if (filter) filter->MarkHit(id);
+    }
+  };
+  visit(node, match_key, node_id);
+  // 明示的なスタックで走査し、パスは単一のスタックをpush/popして共有する
+  // 共有中の要素を複製しないよう、コンテナにはconstでのみ触れる
+  struct SearchFrame {
+    const json* node;
+    json::object_t::const_iterator object_iter;
+    uint32_t index;
+    uint32_t first_child;
+  };
+  auto push_frame = [&](std::vector<SearchFrame>& stack, const json& val, uint32_t id) {
+    json::object_t::const_iterator object_iter;
+    if (val.is_object()) object_iter = val.get_ref<const json::object_t&>().begin();
+    stack.push_back({&val, object_iter, 0, filter ? filter->Push(id, val.size()) : 0});
+  };
+  std::vector<SearchFrame> stack;
+  if (node.is_structured()) {
+    push_frame(stack, node, node_id);
+  }
+  while (!stack.empty()) {
+    SearchFrame& frame = stack.back();
+    if (frame.index == frame.node->size()) {
+      stack.pop_back();
+      if (filter) filter->Pop();
+      // 起点以外のフレームは、親から積まれたキーを取り除く
+      if (!stack.empty()) path.pop_back();
+      continue;
+    }
+    const bool is_key = frame.node->is_object();
+    const uint32_t id = frame.first_child + frame.index;
+    const json* child;
+    if (is_key) {
+      child = &frame.object_iter->second;
+      path.push_back(frame.object_iter->first);
+      ++frame.object_iter;
+    } else {
+      child = &frame.node->get_ref<const json::array_t&>()[frame.index];
+      path.push_back(std::to_string(frame.index));
+    }
+    const json& val = *child;
+    ++frame.index;
+    visit(val, is_key, id);
+    if (val.is_structured()) {
+      push_frame(stack, val, id);
+    } else {
+      path.pop_back();
+    }
+  }
+}
+
+void JsonEditor::OnFilterSubmit() {
+  if (search_query_.empty()) {
+    search_input_->TakeFocus();
+    return;
+  }
+  filter_query_ = search_query_;
+  filter_scope_.clear();
+  if (!search_from_root_) filter_scope_ = current_path_;
+  if (!RebuildFilter()) {
+    filter_active_ = false;
+    search_result_labels_ = {"No results found."};
+    search_input_->TakeFocus();
+    return;
+  }
+  filter_active_ = true;
+  current_path_ = filter_scope_;
+  UpdateBreadcrumbComponent();
+  RefreshTreeAndCloseModal(0);
+}
+
+bool JsonEditor::RebuildFilter() {
+  filter_stale_ = false;
+  filter_ids_ = {0};
+  filter_id_path_ = filter_scope_;
+  if (!HasNode(filter_scope_)) {
+    tree_filter_.Reset();
+    return false;
+  }
+  GetSearchResults(filter_query_, filter_scope_, &tree_filter_);
+  return !tree_filter_.Empty();
+}
+
+bool JsonEditor::SyncFilterPath() {
+  if (filter_stale_ && !RebuildFilter()) {
+    return false;
+  }
+  if (current_path_.size() < filter_scope_.size()
+      || !std::equal(filter_scope_.begin(), filter_scope_.end(), current_path_.begin())) {
+    return false;
+  }
+  // IDが分かっている共通部分より下だけを辿り直す
+  size_t common = filter_scope_.size();
+  while (common < filter_id_path_.size() && common < current_path_.size()
+         && filter_id_path_[common] == current_path_[common]) {
+    ++common;
+  }
+  filter_id_path_.resize(common);
+  filter_ids_.resize(common - filter_scope_.size() + 1);
+  const json* node = &GetNode(filter_id_path_);
+  for (size_t i = common; i < current_path_.size(); ++i) {
+    const std::string& key = current_path_[i];
+    const json* child = nullptr;
+    uint32_t position = 0;
+    if (node->is_array()) {
+      try {
+        position = std::stoul(key);
+        if (position < node->size()) child = &node->get_ref<const json::array_t&>()[position];
+      } catch (...) {}
+    } else if (node->is_object()) {
+      for (const auto& [child_key, value] : node->get_ref<const json::object_t&>()) {
+        if (child_key == key) {
+          child = &value;
+          break;
+        }
+        ++position;
+      }
+    }
+    const uint32_t id = tree_filter_.FirstChild(filter_ids_.back()) + position;
+    // 一致しない枝には入らず、その手前で止める
+    if (!child || !tree_filter_.Contains(id)) break;
+    filter_ids_.push_back(id);
+    filter_id_path_.push_back(key);
+    node = child;
+  }
+  if (current_path_.size() != filter_id_path_.size()) {
+    current_path_ = filter_id_path_;
+    UpdateBreadcrumbComponent();
+  }
+  return true;
+}
+
+void JsonEditor::ClearFilter() {
+  filter_active_ = false;
+  tree_filter_.Reset();
+  UpdateTreeEntries();
+  selected_tree_item_index_ = 0;
+  UpdateEditorPane();
+}
+
+void JsonEditor::OnReplaceSubmit() {
+  if (search_query_.empty()) {
+    search_input_->TakeFocus();
+    return;
+  }
+  std::vector<std::string> scope;
+  if (!search_from_root_) scope = current_path_;
+  const json& root = GetNode(scope);
+  // 並列に処理できるだけのサブツリーが集まるまで階層を下る
+  struct ReplaceTask {
+    const json* node;
+    std::vector<std::string> path;
+  };
+  const size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<ReplaceRecord> records;
+  std::vector<ReplaceTask> tasks;
+  if (root.is_structured()) tasks.push_back({&root, scope});
+  while (!tasks.empty() && tasks.size() < thread_count) {
+    std::vector<ReplaceTask> next_tasks;
+    for (auto& task : tasks) {
+      auto expand = [&](const std::string& key, const json& child) {
+        std::vector<std::string> path = task.path;
+        path.push_back(key);
+        if (child.is_structured()) {
+          next_tasks.push_back({&child, std::move(path)});
+        } else {
+          CollectReplacements(child, path, records);
+        }
+      };
+      if (task.node->is_object()) {
+        for (const auto& [key, child] : task.node->get_ref<const json::object_t&>()) {
+          expand(key, child);
+        }
+      } else {
+        const auto& array = task.node->get_ref<const json::array_t&>();
+        for (size_t index = 0; index < array.size(); ++index) {
+          expand(std::to_string(index), array[index]);
+        }
+      }
+    }
+    if (next_tasks.empty()) {
+      tasks.clear();
+      break;
+    }
+    tasks = std::move(next_tasks);
+  }
+  // 各スレッドは互いに重ならないサブツリーを読むだけで、書き換えは後でまとめて行う
+  std::vector<std::vector<ReplaceRecord>> task_records(tasks.size());
+  std::atomic<size_t> next_task = 0;
+  auto worker = [&] {
+    for (size_t i = next_task++; i < tasks.size(); i = next_task++) {
+      CollectReplacements(*tasks[i].node, tasks[i].path, task_records[i]);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < std::min(thread_count, tasks.size()); ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (auto& task_record : task_records) {
+    std::move(task_record.begin(), task_record.end(), std::back_inserter(records));
+  }
+  if (records.empty()) {
+    editor_hint_ = "No matches to replace.";
+    search_input_->TakeFocus();
+    return;
+  }
+  // 書き換えるパス上のコンテナだけが共有から切り離される
+  SwapReplaceRecords(records);
+  auto shared_records = std::make_shared<std::vector<ReplaceRecord>>(std::move(records));
+  auto swap_records = [this, shared_records]() { SwapReplaceRecords(*shared_records); };
+  size_t bytes = 0;
+  for (const auto& record : *shared_records) {
+    bytes += sizeof(ReplaceRecord) + record.value.capacity();
+    for (const auto& key : record.path) {
+      bytes += sizeof(key) + key.capacity();
+    }
+  }
+  history_manager_.Push({
+    swap_records,
+    swap_records,
+    current_path_,
+    GetCurrentSelectionKey(),
+    bytes,
+  });
+  RefreshTreeAndCloseModal(selected_tree_item_index_);
+  editor_hint_ = "Replaced " + std::to_string(shared_records->size()) + " value(s).";
+}
+
+void JsonEditor::CollectReplacements(const json& node, std::vector<std::string>& path, std::vector<ReplaceRecord>& records) const {
+  auto visit = [&](const json& val) {
+    if (!val.is_string()) return;
+    const std::string& str = val.get_ref<const std::string&>();
+    if (str.find(search_query_) == std::string::npos) return;
+    records.push_back({path, ReplaceAll(str, search_query_, replace_text_)});
+  };
+  visit(node);
+  struct ReplaceFrame {
+    const json* node;
+    json::object_t::const_iterator object_iter;
+    size_t index;
+  };
+  auto push_frame = [&](std::vector<ReplaceFrame>& stack, const json& val) {
+    json::object_t::const_iterator object_iter;
+    if (val.is_object()) object_iter = val.get_ref<const json::object_t&>().begin();
+    stack.push_back({&val, object_iter, 0});
+  };
+  std::vector<ReplaceFrame> stack;
+  if (node.is_structured()) {
+    push_frame(stack, node);
+  }
+  while (!stack.empty()) {
+    ReplaceFrame& frame = stack.back();
+    if (frame.index == frame.node->size()) {
+      stack.pop_back();
+      if (!stack.empty()) path.pop_back();
+      continue;
+    }
+    const json* child;
+    if (frame.node->is_object()) {
+      child = &frame.object_iter->second;
+      path.push_back(frame.object_iter->first);
+      ++frame.object_iter;
+    } else {
+      child = &frame.node->get_ref<const json::array_t&>()[frame.index];
+      path.push_back(std::to_string(frame.index));
+    }
+    ++frame.index;
+    visit(*child);
+    if (child->is_structured()) {
+      push_frame(stack, *child);
+    } else {
+      path.pop_back();
+    }
+  }
+}
+
+void JsonEditor::SwapReplaceRecords(std::vector<ReplaceRecord>& records) {
+  for (auto& record : records) {
+    if (record.path.empty()) continue;
+    std::vector<std::string> parent_path(record.path.begin(), record.path.end() - 1);
+    json swapped = ExecuteEditValue(parent_path, record.path.back(), json(std::move(record.value)));
+    if (swapped.is_string()) {
+      record.value = std::move(swapped.get_ref<std::string&>());
+    }
+  }
+}
+
+void JsonEditor::OnSearchResultEnter() {
+  if (search_results_.empty() || current_search_result_index_ < 0 || current_search_result_index_ >= search_results_.size()) {
+    return;
+  }
   std::vector<std::string> target_path = search_results_[current_search_result_index_];
   std::string target_key = target_path.back();
   target_path.pop_back();
@@ -850,13 +2303,28 @@ Component JsonEditor::BuildHelpModal() {
         vbox({
           text("  Actions") | bold,
           text("    a    : Add Item"),
-          text("    d    : Delete Item"),
+          text("    d    : Delete Item(s)"),
           text("    r    : Rename Key"),
           text("    /    : Search"),
+          text("    f    : Clear Filter"),
           text("    z    : Undo"),
           text("    y    : Redo"),
+          text("    b    : History Branches"),
+          text("    H    : Time Travel"),
           text("    K    : Move Up"),
           text("    J    : Move Down"),
+          text("    m    : Move To..."),
+          text("    Space: Toggle Select"),
+          text("    v    : Select Range"),
+          text("    Esc  : Clear Selection"),
+          text("    c    : Duplicate Item(s)"),
+          text("    t    : Convert Type"),
+          text("    s    : Sort"),
+          text("    u    : Remove Duplicates"),
+          text("    Y    : Yank Item(s)"),
+          text("    x    : Cut Item(s)"),
+          text("    p    : Paste"),
+          text("    w    : Save"),
           text("    ?    : Show Help"),
           text("    q    : Quit"),
         }) | flex | size(WIDTH, GREATER_THAN, 30),
@@ -898,81 +2366,640 @@ void JsonEditor::RefreshTreeAndCloseModal(int focus_index) {
 
 void JsonEditor::PerformUndo() {
   if (history_manager_.CanUndo()) {
-    const EditAction* action = history_manager_.Undo();
-    if (action) {
-      RestoreView(*action);
+    std::optional<HistoryView> view = history_manager_.Undo();
+    if (view) {
+      RestoreView(*view);
     }
   }
 }
 
 void JsonEditor::PerformRedo() {
   if (history_manager_.CanRedo()) {
-    const EditAction* action = history_manager_.Redo();
-    if (action) {
-      RestoreView(*action);
+    std::optional<HistoryView> view = history_manager_.Redo();
+    if (view) {
+      RestoreView(*view);
     }
   }
 }
 
-void JsonEditor::RestoreView(const EditAction& action) {
-  current_path_ = action.path;
+void JsonEditor::RestoreView(const HistoryView& view) {
+  current_path_ = view.path;
+  while (!current_path_.empty() && !HasNode(current_path_)) {
+    current_path_.pop_back();
+  }
+  ClearSelection();
   UpdateBreadcrumbComponent();
   UpdateTreeEntries();
-  const int new_index = GetIndexFromEntries(action.focus_key);
+  const int new_index = GetIndexFromEntries(view.focus_key);
   selected_tree_item_index_ = new_index;
   UpdateEditorPane();
   tree_menu_->TakeFocus();
 }
 
-void JsonEditor::ExecuteEditValue(const std::vector<std::string>& path, const std::string& key, const json& value) {
+void JsonEditor::JournalEdit(const EditOp* op, bool undo) {
+  if (!journal_) return;
+  // 記録する値はドキュメントと構造を共有するため、ここではコピーもシリアライズも起きない
+  if (op) {
+    json record = {{"t", static_cast<int>(op->type)}, {"p", *op->path}};
+    if (undo) record["u"] = true;
+    if (!op->key.empty()) record["k"] = std::string(op->key);
+    if (op->flags & EditOp::kHasOtherKey) record["o"] = std::string(op->other_key);
+    if (op->flags & EditOp::kHasUndoKey) record["q"] = std::string(op->undo_key);
+    if (op->index != 0) record["i"] = op->index;
+    if (op->other_index != 0) record["j"] = op->other_index;
+    if (const json* value = FindAppliedValue(*op, undo)) record["v"] = *value;
+    journal_->Append(std::move(record));
+  } else {
+    // 他の変更箇所の内側にある箇所は、外側の記録に含まれる
+    std::sort(journal_paths_.begin(), journal_paths_.end());
+    journal_paths_.erase(std::unique(journal_paths_.begin(), journal_paths_.end()), journal_paths_.end());
+    const std::vector<std::string>* outer = nullptr;
+    for (const auto& path : journal_paths_) {
+      if (outer && path.size() >= outer->size() && std::equal(outer->begin(), outer->end(), path.begin())) continue;
+      outer = &path;
+      if (!HasNode(path)) continue;
+      // 初期化リストは要素を複製してから破棄するため、共有中の値は1つずつ代入する
+      json record = json::object();
+      record["s"] = path;
+      record["v"] = GetNode(path);
+      journal_->Append(std::move(record));
+    }
+  }
+  journal_paths_.clear();
+}
+
+Component JsonEditor::BuildBranchModal() {
+  MenuOption option;
+  option.on_enter = [this] { OnBranchSubmit(); };
+  branch_menu_ = Menu(&branch_labels_, &branch_index_, option);
+  auto close = [this] { modal_state_ = 0; tree_menu_->TakeFocus(); };
+  auto buttons = Container::Horizontal({
+    Button("Switch", [this] { OnBranchSubmit(); }, GetModalButtonOption()),
+    Button("Cancel", close, GetModalButtonOption()),
+  });
+  auto modal = Container::Vertical({
+    branch_menu_,
+    buttons,
+  });
+  auto modal_renderer = Renderer(modal, [this, buttons] {
+    return vbox({
+      text("History Branches") | center,
+      separator(),
+      branch_menu_->Render() | vscroll_indicator | frame | size(HEIGHT, LESS_THAN, 12),
+      text("Switching can be undone with [z].") | dim,
+      separator(),
+      buttons->Render() | center,
+    }) | border | size(WIDTH, GREATER_THAN, 40);
+  });
+  return ApplyModalBehavors(modal_renderer);
+}
+
+bool JsonEditor::OnOpenBranchModal() {
+  const auto& branches = history_manager_.Branches();
+  if (branches.empty()) {
+    editor_hint_ = "No history branches.";
+    return false;
+  }
+  // 新しい枝を上に並べる
+  branch_labels_.clear();
+  for (auto iter = branches.rbegin(); iter != branches.rend(); ++iter) {
+    branch_labels_.push_back(FormatClock(iter->time, false) + "  " + std::to_string(iter->edit_count) + " edit(s)  " + FormatLocation(iter->view.path, iter->view.focus_key));
+  }
+  branch_index_ = 0;
+  modal_state_ = 9;
+  branch_menu_->TakeFocus();
+  return true;
+}
+
+void JsonEditor::OnBranchSubmit() {
+  const size_t count = history_manager_.Branches().size();
+  if (branch_index_ < 0 || branch_index_ >= count) return;
+  HistoryBranch branch = history_manager_.TakeBranch(count - 1 - branch_index_);
+  // 先端とドキュメントを根ごと入れ替える。構造を共有しているため、ドキュメントの大きさによらない。
+  // 入れ替えた値もドキュメントと構造を共有するため、破棄するときは複製せずに手放す
+  auto other = std::shared_ptr<json>(new json(std::move(branch.snapshot)), [](json* value) {
+    ReleaseJson(*value);
+    delete value;
+  });
+  auto swap_document = [this, other]() { SwapDocument(*other); };
+  swap_document();
+  history_manager_.Push({
+    swap_document,
+    swap_document,
+    branch.view.path,
+    branch.view.focus_key,
+  });
+  modal_state_ = 0;
+  RestoreView(branch.view);
+  editor_hint_ = "Switched to a history branch.";
+}
+
+void JsonEditor::SwapDocument(json& other) {
+  MarkModified({});
+  input_json_.swap(other);
+}
+
+void JsonEditor::RecordTimeline(const EditOp* op, bool undo, const HistoryView& view) {
+  // 記録する値とチェックポイントはドキュメントと構造を共有するため、大きさによらずO(1)
+  if (!op) {
+    timeline_.RecordSnapshot(input_json_, view.path, view.focus_key);
+  } else {
+    const json* value = FindAppliedValue(*op, undo);
+    timeline_.RecordOp(*op, undo, value ? *value : json(), view.focus_key, input_json_);
+  }
+  EvictTimeline();
+}
+
+void JsonEditor::EvictTimeline() {
+  // タイムラインはUndo履歴と上限を分け合い、履歴が使っていない分に収める
+  const size_t used = history_manager_.UsedBytes();
+  timeline_.Evict(used < history_budget_ ? history_budget_ - used : 0);
+}
+
+const json* JsonEditor::FindAppliedValue(const EditOp& op, bool undo) const {
+  if (!EditOpHoldsValue(op.type) || !HasNode(*op.path)) return nullptr;
+  // 取り除く向きでは値が入らない。配列ではindexに詰めてきた別の要素を指すため、探さずに除く
+  switch (op.type) {
+    case EditOpType::kAddKey:
+    case EditOpType::kPushElement:
+      if (undo) return nullptr;
+      break;
+    case EditOpType::kRemoveKey:
+    case EditOpType::kRemoveElement:
+      if (!undo) return nullptr;
+      break;
+    default:
+      break;
+  }
+  const bool is_element = op.type == EditOpType::kPushElement || op.type == EditOpType::kRemoveElement;
+  return FindChild(GetNode(*op.path), is_element ? std::to_string(op.index) : std::string(op.key));
+}
+
+Component JsonEditor::BuildTimelineModal() {
+  auto slider = Slider("", &timeline_step_, 0, &timeline_last_, 1);
+  timeline_slider_ = slider | CatchEvent([this, slider](Event event) {
+    const int page = std::max(1, timeline_last_ / 20);
+    bool handled = true;
+    if (event == Event::Home) timeline_step_ = 0;
+    else if (event == Event::End) timeline_step_ = timeline_last_;
+    else if (event == Event::PageUp) timeline_step_ = std::max(0, timeline_step_ - page);
+    else if (event == Event::PageDown) timeline_step_ = std::min(timeline_last_, timeline_step_ + page);
+    else handled = slider->OnEvent(event);
+    // スライダーが動いたら、その時点の状態を組み立てる
+    if (timeline_step_ != timeline_shown_step_) SeekTimeline(timeline_step_);
+    return handled;
+  });
+  auto buttons = Container::Horizontal({
+    Button("Restore", [this] { OnTimelineClose(true); }, GetModalButtonOption()),
+    Button("Close", [this] { OnTimelineClose(false); }, GetModalButtonOption()),
+  });
+  auto modal = Container::Vertical({
+    timeline_slider_,
+    buttons,
+  });
+  modal |= CatchEvent([this](Event event) {
+    if (event == Event::Escape) {
+      OnTimelineClose(false);
+      return true;
+    }
+    return false;
+  });
+  return Renderer(modal, [this, buttons] {
+    const TimelinePoint point = timeline_.Point(timeline_shown_step_);
+    return vbox({
+      hbox({
+        text("Time Travel") | bold,
+        text("  Step " + std::to_string(timeline_shown_step_) + " / " + std::to_string(timeline_last_)),
+        filler(),
+        text(FormatClock(point.time, true)),
+      }),
+      timeline_slider_->Render(),
+      hbox({
+        text(timeline_shown_step_ == 0 ? (timeline_.Truncated() ? "Oldest kept" : "Opened") : FormatLocation(point.path, point.focus_key)) | dim,
+        filler(),
+        text("[←/→] Step  [PgUp/PgDn] Jump  [Home/End] First/Last") | dim,
+      }),
+      separator(),
+      buttons->Render() | center,
+    }) | border;
+  });
+}
+
+bool JsonEditor::OnOpenTimelineModal() {
+  if (timeline_.Size() <= 1) {
+    editor_hint_ = "No history to travel.";
+    return false;
+  }
+  // フィルタはドキュメント全体を走査し直すため、時点を移るたびに作り直さないよう解除する
+  if (filter_active_) ClearFilter();
+  timeline_present_ = input_json_;
+  timeline_present_view_ = {current_path_, GetCurrentSelectionKey()};
+  timeline_present_dirty_set_ = dirty_set_;
+  timeline_last_ = static_cast<int>(timeline_.Size() - 1);
+  timeline_step_ = timeline_last_;
+  timeline_shown_step_ = timeline_last_;
+  modal_state_ = 10;
+  timeline_slider_->TakeFocus();
+  return true;
+}
+
+void JsonEditor::SeekTimeline(int step) {
+  MarkModified({});
+  timeline_.Seek(step, input_json_, [this](const EditOp& op, bool undo) { ApplyEditOp(op, undo); });
+  timeline_shown_step_ = step;
+  const TimelinePoint point = timeline_.Point(step);
+  RestoreView({point.path, point.focus_key});
+  // RestoreViewで木へ移ったフォーカスをスライダーへ戻す
+  modal_state_ = 10;
+  timeline_slider_->TakeFocus();
+}
+
+void JsonEditor::OnTimelineClose(bool restore) {
+  modal_state_ = 0;
+  if (restore && timeline_shown_step_ != timeline_last_) {
+    // 開く前のドキュメントと入れ替える操作として残し、Undoで戻れるようにする
+    auto other = std::shared_ptr<json>(new json(std::move(timeline_present_)), [](json* value) {
+      ReleaseJson(*value);
+      delete value;
+    });
+    auto swap_document = [this, other]() { SwapDocument(*other); };
+    const TimelinePoint point = timeline_.Point(timeline_shown_step_);
+    history_manager_.Push({
+      swap_document,
+      swap_document,
+      point.path,
+      point.focus_key,
+    });
+    RestoreView({point.path, point.focus_key});
+    editor_hint_ = "Restored step " + std::to_string(timeline_shown_step_) + ".";
+    return;
+  }
+  // 時点を移る間に記録した変更箇所は、ジャーナルに書くべき変更でも保存で書き直す変更でもない
+  if (timeline_shown_step_ != timeline_last_) SwapDocument(timeline_present_);
+  ReleaseJson(timeline_present_);
+  journal_paths_.clear();
+  dirty_set_ = std::move(timeline_present_dirty_set_);
+  RestoreView(timeline_present_view_);
+}
+
+HistoryView JsonEditor::ApplyEditOp(const EditOp& op, bool undo) {
+  const std::vector<std::string>& path = *op.path;
+  const std::string key(op.key);
+  switch (op.type) {
+    case EditOpType::kReplace:
+      *op.value = ExecuteEditValue(path, key, std::move(*op.value));
+      return {path, key};
+    case EditOpType::kAddKey:
+      if (undo) *op.value = ExecuteRemoveKey(path, key);
+      else ExecuteAddKey(path, key, std::move(*op.value));
+      return {path, key};
+    case EditOpType::kRemoveKey:
+      if (undo) {
+        // 削除前の位置へ戻す
+        std::vector<BulkRecord> records{{op.index, key, std::move(*op.value)}};
+        ExecuteInsertEntries(path, records);
+      } else {
+        *op.value = ExecuteRemoveKey(path, key);
+      }
+      return {path, key};
+    case EditOpType::kPushElement:
+      if (undo) *op.value = ExecuteRemoveLastArrayElement(path);
+      else ExecuteAddArrayElement(path, std::move(*op.value));
+      return {path, std::to_string(op.index)};
+    case EditOpType::kRemoveElement:
+      if (undo) ExecuteInsertArrayElement(path, op.index, std::move(*op.value));
+      else *op.value = ExecuteRemoveArrayElement(path, op.index);
+      return {path, std::to_string(op.index > 0 ? op.index - 1 : 0)};
+    case EditOpType::kRenameKey: {
+      const std::string other_key(op.other_key);
+      if (undo) ExecuteRenameKey(path, other_key, key);
+      else ExecuteRenameKey(path, key, other_key);
+      return {path, undo ? key : other_key};
+    }
+    case EditOpType::kMoveKey: {
+      const int direction = op.index == 0 ? -1 : 1;
+      ExecuteMoveKey(path, key, undo ? -direction : direction);
+      return {path, key};
+    }
+    case EditOpType::kMoveKeyBefore: {
+      std::optional<std::string> before_key;
+      if (undo && (op.flags & EditOp::kHasUndoKey)) before_key = std::string(op.undo_key);
+      if (!undo && (op.flags & EditOp::kHasOtherKey)) before_key = std::string(op.other_key);
+      ExecuteMoveKeyBefore(path, key, before_key);
+      return {path, key};
+    }
+    case EditOpType::kMoveElement:
+      if (undo) ExecuteMoveElement(path, op.other_index, op.index);
+      else ExecuteMoveElement(path, op.index, op.other_index);
+      return {path, std::to_string(undo ? op.index : op.other_index)};
+  }
+  return {path, key};
+}
+
+json JsonEditor::ExecuteEditValue(const std::vector<std::string>& path, const std::string& key, json value) {
+  MarkModified(path, key);
   json& parent = GetNode(input_json_, path);
   if (parent.is_array()) {
     try {
-      parent[std::stoul(key)] = value;
+      std::swap(parent.at(std::stoul(key)), value);
     } catch (...) {}
   } else {
-    parent[key] = value;
+    std::swap(parent[key], value);
   }
+  return value;
 }
 
-void JsonEditor::ExecuteAddKey(const std::vector<std::string>& path, const std::string& key, const json& value) {
-  GetNode(input_json_, path)[key] = value;
+void JsonEditor::ExecuteAddKey(const std::vector<std::string>& path, const std::string& key, json value) {
+  MarkModified(path);
+  GetNode(input_json_, path)[key] = std::move(value);
 }
 
-void JsonEditor::ExecuteRemoveKey(const std::vector<std::string>& path, const std::string& key) {
-  GetNode(input_json_, path).erase(key);
+json JsonEditor::ExecuteRemoveKey(const std::vector<std::string>& path, const std::string& key) {
+  MarkModified(path);
+  json removed;
+  json& node = GetNode(input_json_, path);
+  if (!node.is_object()) return removed;
+  auto& object = node.get_ref<json::object_t&>();
+  auto iter = object.find(key);
+  if (iter != object.end()) {
+    removed = std::move(iter->second);
+    object.erase(iter);
+  }
+  return removed;
 }
 
-void JsonEditor::ExecuteAddArrayElement(const std::vector<std::string>& path, const json& value) {
-  GetNode(input_json_, path).push_back(value);
+void JsonEditor::ExecuteAddArrayElement(const std::vector<std::string>& path, json value) {
+  MarkModified(path);
+  GetNode(input_json_, path).push_back(std::move(value));
 }
 
-void JsonEditor::ExecuteRemoveLastArrayElement(const std::vector<std::string>& path) {
+json JsonEditor::ExecuteRemoveLastArrayElement(const std::vector<std::string>& path) {
+  MarkModified(path);
+  json removed;
   json& arr = GetNode(input_json_, path);
-  if (!arr.empty()) arr.erase(arr.size() - 1);
+  if (arr.is_array() && !arr.empty()) {
+    auto& array = arr.get_ref<json::array_t&>();
+    // back()は複製しないため、添字で取り出して共有中の配列から要素を奪わないようにする
+    removed = std::move(array[array.size() - 1]);
+    array.pop_back();
+  }
+  return removed;
 }
 
-void JsonEditor::ExecuteInsertArrayElement(const std::vector<std::string>& path, int index, const json& value) {
+void JsonEditor::ExecuteInsertArrayElement(const std::vector<std::string>& path, int index, json value) {
+  MarkModified(path);
   json& arr = GetNode(input_json_, path);
-  if (arr.is_array()) {
-    auto iter = arr.begin();
-    if (index <= arr.size()) {
-      arr.insert(iter + index, value);
-    }
+  if (arr.is_array() && index <= arr.size()) {
+    // basic_json::insertは右辺値でもコピーするため、配列を直接操作する
+    auto& array = arr.get_ref<json::array_t&>();
+    array.insert(array.begin() + index, std::move(value));
   }
 }
 
-void JsonEditor::ExecuteRemoveArrayElement(const std::vector<std::string>& path, int index) {
+json JsonEditor::ExecuteRemoveArrayElement(const std::vector<std::string>& path, int index) {
+  MarkModified(path);
+  json removed;
   json& arr = GetNode(input_json_, path);
   if (arr.is_array() && index < arr.size()) {
-    arr.erase(index);
+    auto& array = arr.get_ref<json::array_t&>();
+    removed = std::move(array[index]);
+    array.erase(array.begin() + index);
   }
+  return removed;
 }
 
 void JsonEditor::ExecuteRenameKey(const std::vector<std::string>& path, const std::string& old_key, const std::string& new_key) {
+  MarkModified(path);
+  json& node = GetNode(input_json_, path);
+  if (!node.is_object()) return;
+  auto& object = node.get_ref<json::object_t&>();
+  auto iter = object.find(old_key);
+  if (iter == object.end()) return;
+  object.Rename(iter, new_key);
+}
+
+std::vector<BulkRecord> JsonEditor::ExecuteRemoveEntries(const std::vector<std::string>& path, const std::vector<size_t>& positions) {
+  MarkModified(path);
+  std::vector<BulkRecord> removed;
+  json& node = GetNode(input_json_, path);
+  removed.reserve(positions.size());
+  if (node.is_array()) {
+    // 残す要素を前へ詰めながら、取り除く要素を記録へ移す
+    auto& array = node.get_ref<json::array_t&>();
+    size_t write = 0;
+    size_t next = 0;
+    for (size_t read = 0; read < array.size(); ++read) {
+      if (next < positions.size() && positions[next] == read) {
+        removed.push_back({read, "", std::move(array[read])});
+        ++next;
+      } else {
+        if (write != read) array[write] = std::move(array[read]);
+        ++write;
+      }
+    }
+    array.erase(array.begin() + write, array.end());
+  } else if (node.is_object()) {
+    auto& object = node.get_ref<json::object_t&>();
+    auto iter = object.begin();
+    size_t position = 0;
+    for (size_t target : positions) {
+      // 取り除いた分だけ後ろの要素の位置が前にずれる
+      const size_t current = target - removed.size();
+      std::advance(iter, current - position);
+      position = current;
+      if (iter == object.end()) break;
+      removed.push_back({target, iter->first, std::move(iter->second)});
+      iter = object.erase(iter);
+    }
+  }
+  return removed;
+}
+
+void JsonEditor::ExecuteInsertEntries(const std::vector<std::string>& path, std::vector<BulkRecord>& records) {
+  MarkModified(path);
+  json& node = GetNode(input_json_, path);
+  if (node.is_array()) {
+    // 既存の要素と挿入する要素を位置順に並べた配列を1回で作る
+    auto& array = node.get_ref<json::array_t&>();
+    json::array_t merged;
+    merged.reserve(array.size() + records.size());
+    auto iter = array.begin();
+    for (auto& record : records) {
+      while (merged.size() < record.position && iter != array.end()) {
+        merged.push_back(std::move(*iter++));
+      }
+      merged.push_back(std::move(record.value));
+    }
+    std::move(iter, array.end(), std::back_inserter(merged));
+    array.swap(merged);
+  } else if (node.is_object()) {
+    auto& object = node.get_ref<json::object_t&>();
+    auto iter = object.begin();
+    size_t position = 0;
+    for (auto& record : records) {
+      while (position < record.position && iter != object.end()) {
+        ++iter;
+        ++position;
+      }
+      object.InsertBefore(iter, record.key, std::move(record.value));
+      ++position;
+    }
+  }
+}
+
+void JsonEditor::ExecuteSwapEntries(const std::vector<std::string>& path, const std::vector<size_t>& swaps, bool reverse) {
+  MarkModified(path);
+  json& node = GetNode(input_json_, path);
+  auto apply = [&](auto&& swap_at) {
+    if (reverse) std::for_each(swaps.rbegin(), swaps.rend(), swap_at);
+    else std::for_each(swaps.begin(), swaps.end(), swap_at);
+  };
+  if (node.is_array()) {
+    auto& array = node.get_ref<json::array_t&>();
+    apply([&](size_t position) {
+      if (position + 1 < array.size()) std::swap(array[position], array[position + 1]);
+    });
+  } else if (node.is_object()) {
+    // 位置から要素を引けるよう一度だけ並べ、以降はリストの付け替えで入れ替える
+    auto& object = node.get_ref<json::object_t&>();
+    std::vector<json::object_t::iterator> items;
+    items.reserve(object.size());
+    for (auto iter = object.begin(); iter != object.end(); ++iter) {
+      items.push_back(iter);
+    }
+    apply([&](size_t position) {
+      if (position + 1 >= items.size()) return;
+      object.MoveBefore(items[position + 1], items[position]);
+      std::swap(items[position], items[position + 1]);
+    });
+  }
+}
+
+void JsonEditor::ExecuteSwapValues(const std::vector<std::string>& path, std::vector<BulkRecord>& records) {
+  MarkModified(path);
+  json& node = GetNode(input_json_, path);
+  if (node.is_array()) {
+    auto& array = node.get_ref<json::array_t&>();
+    for (auto& record : records) {
+      if (record.position < array.size()) std::swap(array[record.position], record.value);
+    }
+  } else if (node.is_object()) {
+    auto& object = node.get_ref<json::object_t&>();
+    auto iter = object.begin();
+    size_t position = 0;
+    for (auto& record : records) {
+      std::advance(iter, record.position - position);
+      position = record.position;
+      if (iter == object.end()) break;
+      std::swap(iter->second, record.value);
+    }
+  }
+}
+
+void JsonEditor::ExecutePermuteEntries(const std::vector<std::string>& path, const std::vector<uint32_t>& order, bool inverse) {
+  MarkModified(path);
   json& node = GetNode(input_json_, path);
-  node[new_key] = node[old_key];
-  node.erase(old_key);
+  if (!node.is_structured() || node.size() != order.size()) return;
+  // 新しい各位置に、現在どの位置の要素を置くか
+  std::vector<uint32_t> inverse_order;
+  if (inverse) {
+    inverse_order.resize(order.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+      inverse_order[order[i]] = i;
+    }
+  }
+  const std::vector<uint32_t>& sources = inverse ? inverse_order : order;
+  if (node.is_array()) {
+    auto& array = node.get_ref<json::array_t&>();
+    json::array_t permuted;
+    permuted.reserve(array.size());
+    for (uint32_t source : sources) {
+      permuted.push_back(std::move(array[source]));
+    }
+    array.swap(permuted);
+  } else {
+    // オブジェクトはリストの付け替えだけで並べ、値は動かさない
+    auto& object = node.get_ref<json::object_t&>();
+    std::vector<json::object_t::iterator> items;
+    items.reserve(object.size());
+    for (auto iter = object.begin(); iter != object.end(); ++iter) {
+      items.push_back(iter);
+    }
+    for (uint32_t source : sources) {
+      object.MoveBefore(items[source], object.end());
+    }
+  }
+}
+
+void JsonEditor::ExecuteRemoveDuplicates(const std::vector<std::string>& path, const std::vector<uint32_t>& removed) {
+  std::vector<BulkRecord> records = ExecuteRemoveEntries(path, std::vector<size_t>(removed.begin(), removed.end()));
+  // 取り除いた値は残した要素とコンテナを共有していることがあるため、複製せずに手放す
+  for (auto& record : records) {
+    ReleaseJson(record.value);
+  }
+}
+
+void JsonEditor::ExecuteRestoreDuplicates(const std::vector<std::string>& path, const std::vector<uint32_t>& removed, const std::vector<uint32_t>& sources) {
+  const json& node = GetNode(path);
+  if (!node.is_array()) return;
+  // 取り除いた要素は残した要素と同一のため、その値を共有して戻す
+  const auto& array = node.get_ref<const json::array_t&>();
+  std::vector<BulkRecord> records;
+  records.reserve(removed.size());
+  for (size_t i = 0; i < removed.size(); ++i) {
+    // 残した要素は、それより前で取り除いた数だけ前にずれている
+    const size_t shift = std::lower_bound(removed.begin(), removed.end(), sources[i]) - removed.begin();
+    records.push_back({removed[i], "", array[sources[i] - shift]});
+  }
+  ExecuteInsertEntries(path, records);
+}
+
+void JsonEditor::MarkModified(const std::vector<std::string>& path) {
+  dirty_set_.Mark(path);
+  if (journal_) journal_paths_.push_back(path);
+  if (filter_active_) filter_stale_ = true;
+  search_cache_.Invalidate(path);
+  document_version_.Touch(path);
+}
+
+void JsonEditor::MarkModified(const std::vector<std::string>& path, const std::string& key) {
+  std::vector<std::string> child_path = path;
+  child_path.push_back(key);
+  MarkModified(child_path);
+}
+
+bool JsonEditor::HasNode(const std::vector<std::string>& path) const {
+  const json* node = &input_json_;
+  for (const auto& key_or_index : path) {
+    node = FindChild(*node, key_or_index);
+    if (!node) return false;
+  }
+  return true;
+}
+
+const json& JsonEditor::GetNode(const std::vector<std::string>& path) const {
+  const json* node = &input_json_;
+  for (const auto& key_or_index : path) {
+    node = FindChild(*node, key_or_index);
+    if (!node) return input_json_;
+  }
+  return *node;
+}
+
+const json* JsonEditor::FindChild(const json& node, const std::string& key) const {
+  if (node.is_object()) {
+    const auto& object = node.get_ref<const json::object_t&>();
+    auto iter = object.find(key);
+    return iter == object.end() ? nullptr : &iter->second;
+  }
+  if (node.is_array()) {
+    const auto& array = node.get_ref<const json::array_t&>();
+    try {
+      size_t index = std::stoul(key);
+      return index < array.size() ? &array[index] : nullptr;
+    } catch (...) {}
+  }
+  return nullptr;
 }
 
 json& JsonEditor::GetNode(json& root, const std::vector<std::string>& path) const {
@@ -992,6 +3019,49 @@ json& JsonEditor::GetNode(json& root, const std::vector<std::string>& path) cons
   return *node;
 }
 
+size_t JsonEditor::EstimateRecordBytes(const std::vector<BulkRecord>& records) const {
+  size_t bytes = records.capacity() * sizeof(BulkRecord);
+  for (const auto& record : records) {
+    // 値自体はBulkRecordに含まれるため、その分を除く
+    bytes += record.key.capacity() + EstimateJsonBytes(record.value) - sizeof(json);
+  }
+  return bytes;
+}
+
+std::string JsonEditor::FormatBytes(size_t bytes) const {
+  const char* units[] = {"B", "KB", "MB", "GB"};
+  double value = static_cast<double>(bytes);
+  size_t unit = 0;
+  while (value >= 1024 && unit + 1 < std::size(units)) {
+    value /= 1024;
+    ++unit;
+  }
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), unit == 0 ? "%.0f %s" : "%.1f %s", value, units[unit]);
+  return buffer;
+}
+
+std::string JsonEditor::JoinPath(const std::vector<std::string>& path) const {
+  std::string joined;
+  for (size_t i = 0; i < path.size(); ++i) {
+    if (i > 0) joined += " > ";
+    joined += path[i];
+  }
+  return joined;
+}
+
+std::string JsonEditor::ReplaceAll(const std::string& str, const std::string& from, const std::string& to) const {
+  std::string replaced;
+  size_t begin = 0;
+  for (size_t pos = str.find(from); pos != std::string::npos; pos = str.find(from, begin)) {
+    replaced.append(str, begin, pos - begin);
+    replaced += to;
+    begin = pos + from.size();
+  }
+  replaced.append(str, begin, std::string::npos);
+  return replaced;
+}
+
 std::string JsonEditor::CleanStringForJson(std::string str) const {
   str.erase(std::remove(str.begin(), str.end(), '\n'), str.end());
   return str;
@@ -1004,7 +3074,7 @@ std::string JsonEditor::GetCurrentSelectionKey() {
   return entries_[selected_tree_item_index_].key;
 }
 
-json* JsonEditor::GetCurrentSelectedNode(std::string& out_key) const {
+const json* JsonEditor::GetCurrentSelectedNode(std::string& out_key) const {
   if (entries_.empty() || selected_tree_item_index_ < 0 || selected_tree_item_index_ >= entries_.size()) {
     out_key = "[None]";
     return nullptr;
@@ -1015,19 +3085,7 @@ json* JsonEditor::GetCurrentSelectedNode(std::string& out_key) const {
     return nullptr;
   }
   out_key = entry.key;
-  json& parent_node = GetNode(input_json_, current_path_);
-  if (parent_node.is_array()) {
-    try {
-      return &parent_node[std::stoul(out_key)];
-    } catch (...) {
-      return nullptr;
-    }
-  } else if (parent_node.is_object()) {
-    if (parent_node.contains(out_key)) {
-      return &parent_node[out_key];
-    }
-  }
-  return nullptr;
+  return FindChild(GetNode(current_path_), out_key);
 }
 
 int JsonEditor::GetIndexFromEntries(const std::string& key) const {
@@ -1039,6 +3097,15 @@ int JsonEditor::GetIndexFromEntries(const std::string& key) const {
   return -1;
 }
 
+int JsonEditor::GetIndexFromPosition(size_t position) const {
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    if (entries_[i].key != ".." && entries_[i].position >= position) {
+      return static_cast<int>(i);
+    }
+  }
+  return static_cast<int>(entries_.size()) - 1;
+}
+
 Decorator JsonEditor::GetColorFromType(const json::value_t type) const {
   switch (type) {
     case json::value_t::array:            return color(Color::MagentaLight);
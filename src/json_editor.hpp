@@ -1,7 +1,16 @@
 #pragma once
 
+#include "auto_saver.hpp"
 #include "breadcrumbs.hpp"
+#include "dirty_set.hpp"
+#include "document_version.hpp"
+#include "edit_log.hpp"
+#include "journal.hpp"
 #include "json_types.hpp"
+#include "parallel_sort.hpp"
+#include "search_cache.hpp"
+#include "timeline.hpp"
+#include "tree_filter.hpp"
 
 #include <ftxui/component/component.hpp>
 #include <ftxui/component/screen_interactive.hpp>
@@ -12,7 +21,18 @@
 #include <iostream>
 #include <functional>
 #include <algorithm>
+#include <cstdio>
+#include <cctype>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <deque>
 #include <stack>
+#include <atomic>
+#include <thread>
+#include <unordered_set>
+#include <chrono>
+#include <ctime>
 
 using namespace ftxui;
 using json = ordered_json;
@@ -22,21 +42,109 @@ struct TreeEntry {
   std::string label;
   std::string key;
   json::value_t type;
+  // 親ノード内での位置。".."では使わない
+  size_t position = 0;
 };
 
-/// @brief 操作単位
+/// @brief 置換で書き換えた値の記録
+struct ReplaceRecord {
+  std::vector<std::string> path;
+  // ドキュメントに入っていない側の値。Undo/Redoのたびに入れ替わる。
+  std::string value;
+};
+
+/// @brief 一括操作で出し入れする要素の記録
+struct BulkRecord {
+  // 親ノード内での位置
+  size_t position;
+  // オブジェクトのキー。配列では使わない
+  std::string key;
+  json value;
+};
+
+/// @brief 関数で表した操作。ログの操作で表せない一括操作に使う
 struct EditAction {
   std::function<void()> undo;
   std::function<void()> redo;
   std::vector<std::string> path;
   std::string focus_key;
+  // 操作が保持する値のおおよそのバイト数。履歴に積むと操作自体の大きさも加えられる
+  size_t bytes = 0;
+};
+
+/// @brief Undo/Redoの後に表示する位置
+struct HistoryView {
+  std::vector<std::string> path;
+  std::string focus_key;
+};
+
+/// @brief 新しい編集で分かれた履歴の枝
+struct HistoryBranch {
+  // 枝の先端のドキュメント。ドキュメントと構造を共有する
+  json snapshot;
+  HistoryView view;
+  // 枝の最後の編集時刻
+  std::chrono::system_clock::time_point time;
+  // 分かれた位置から先端までの操作の数
+  size_t edit_count = 0;
 };
 
 /// @brief 履歴管理
+/// 単純な操作はEditLogに詰めて記録し、一括操作は関数で記録する。
+/// 同じノードへの続けざまの操作は1回のUndo/Redoでまとめて戻る。
+/// Undoした後に新しい編集をすると、Redoできた先の状態を枝として残す。
+/// 保持する値のバイト数を数え、上限を超えたら古い操作から捨てる。
 class HistoryManager {
  public:
-  /// @brief 操作を保存する。
-  void Push(const EditAction& action);
+  static constexpr size_t kDefaultBudget = 256 * 1024 * 1024;
+  // 同じノードへの操作をまとめる、直前の操作からの経過時間の上限
+  static constexpr std::chrono::milliseconds kCoalesceWindow{1000};
+  static constexpr size_t kMaxBranches = 32;
+
+  /// @brief ログ上の操作を実行する関数。undoがtrueなら逆操作を行う。
+  /// 実行後に表示する位置を返す。
+  using Applier = std::function<HistoryView(const EditOp& op, bool undo)>;
+
+  /// @brief 操作が実行されるたびに呼ばれる関数。opはログ上の操作で、関数で表した操作ではnullptr。
+  /// viewは操作で変更のあった位置。
+  using Observer = std::function<void(const EditOp* op, bool undo, const HistoryView& view)>;
+
+  /// @brief ドキュメントの複製を得る関数。複製は構造を共有するため、大きさによらずO(1)で得られる。
+  using Snapshotter = std::function<json()>;
+
+  /// @brief ログ上の操作を実行する関数を設定する。
+  void SetApplier(Applier applier);
+
+  /// @brief 操作の記録やUndo/Redoのたびに呼ばれる関数を設定する。
+  void SetObserver(Observer observer);
+
+  /// @brief 枝を残すためにドキュメントの複製を得る関数を設定する。設定しなければ枝は残らない。
+  void SetSnapshotter(Snapshotter snapshotter);
+
+  /// @brief 残っている枝の一覧。古いものが先頭。
+  const std::deque<HistoryBranch>& Branches() const;
+
+  /// @brief 枝を一覧から取り出す。
+  /// @param index 取り出す枝の番号。
+  HistoryBranch TakeBranch(size_t index);
+
+  /// @brief 関数で表した操作を保存する。
+  void Push(EditAction action);
+
+  /// @brief 実行済みの操作をログに記録する。
+  /// @param op 記録する操作。
+  /// @param value 操作が保持する値。
+  void Record(const EditOp& op, json value = nullptr);
+
+  /// @brief 履歴が使うメモリの上限を設定する。超えている分は古い操作から捨てる。
+  /// @param bytes 上限のバイト数。
+  void SetBudget(size_t bytes);
+
+  /// @brief 履歴が使うメモリの上限。
+  size_t Budget() const;
+
+  /// @brief 履歴が保持しているおおよそのバイト数。
+  size_t UsedBytes() const;
 
   /// @brief Undo可能か。
   bool CanUndo() const;
@@ -45,16 +153,63 @@ class HistoryManager {
   bool CanRedo() const;
   
   /// @brief Undoを実行する。
-  /// @return Undoした操作。
-  const EditAction* Undo();
+  /// @return Undoした操作の表示位置。
+  std::optional<HistoryView> Undo();
 
   /// @brief Redoを実行する。
-  /// @return Redoした操作。
-  const EditAction* Redo();
+  /// @return Redoした操作の表示位置。
+  std::optional<HistoryView> Redo();
 
  private:
-  std::stack<EditAction> undo_stack_;
-  std::stack<EditAction> redo_stack_;
+  /// @brief 履歴の1項目。ログ上の操作か、関数で表した操作のどちらか
+  struct HistoryEntry {
+    // ログ上の操作の位置。actionがあれば使わない
+    uint64_t offset = 0;
+    size_t bytes = 0;
+    std::unique_ptr<EditAction> action;
+    // 記録した時刻。まとめた操作では最後の操作の時刻
+    std::chrono::system_clock::time_point time;
+    // 直前の項目とまとめてUndo/Redoするか
+    bool joined = false;
+  };
+
+  /// @brief Redoの履歴を捨てる。Undo前の先端を保存していれば枝として残す。
+  void DiscardRedo();
+
+  /// @brief 保存していた先端を捨てる。
+  void ResetTip();
+
+  /// @brief 項目を追加する。
+  void PushEntry(HistoryEntry entry);
+
+  /// @brief 項目の操作を実行する。
+  HistoryView Apply(const HistoryEntry& entry, bool undo);
+
+  /// @brief 記録する操作を直前の操作とまとめるか決める。
+  /// @param op 記録する操作。
+  /// @param[out] merge 直前の操作に吸収でき、記録が要らなければtrue。
+  /// @return 直前の操作とまとめるならtrue。
+  bool Coalesces(const EditOp& op, bool& merge);
+
+  /// @brief 先頭から数えて、1回のUndoでまとめて戻る項目の数。
+  size_t GroupSize(size_t begin) const;
+
+  /// @brief 上限を超えている間、最も古い操作を捨てる。最新の操作は残す。
+  void Evict();
+
+  EditLog log_;
+  Applier apply_;
+  Observer observe_;
+  Snapshotter snapshot_;
+  // 最新の状態からUndoしたときに保存した先端。Redoで最新に戻るか、枝になると空になる
+  std::optional<HistoryBranch> tip_;
+  std::deque<HistoryBranch> branches_;
+  // cursor_より前がUndoできる操作、以降がRedoできる操作。
+  // Undo/Redoはcursor_を動かすだけで、項目を移したりコピーしたりしない。上限を超えると先頭から捨てる
+  std::deque<HistoryEntry> entries_;
+  size_t cursor_ = 0;
+  size_t budget_ = kDefaultBudget;
+  size_t used_bytes_ = 0;
 };
 
 
@@ -69,6 +224,38 @@ class JsonEditor {
   /// @brief 最終的なレンダリングコンポーネントを取得する。
   Component GetLayout();
 
+  /// @brief Undo履歴とタイムラインが使うメモリの上限を設定する。
+  /// Undo履歴は上限の一部までに抑え、タイムラインはUndo履歴が使っていない残りに収める。
+  /// @param bytes 上限のバイト数。
+  void SetHistoryBudget(size_t bytes);
+
+  /// @brief 読み込んだファイルへドキュメントを保存する。裏で保存中ならそれを待ってから保存する。
+  /// ファイルが前回の保存から書き換えられていなければ、変更のあったサブツリーだけを書き直し、他の部分は元の書式のまま残す。
+  /// そうでなければ全体を直列化して保存する。どちらも一時ファイルを経由して置き換える。
+  /// @param[out] error 失敗した理由。
+  /// @return 保存できたらtrue。
+  bool Save(std::string& error);
+
+  /// @brief 裏での保存を開始する。以降はwキーを押したときと一定の間隔ごとに、変更があれば保存スレッドで保存する。
+  /// @param poster UIのスレッドで処理を実行させ、画面を描き直させる関数。
+  /// @param interval 保存する間隔。0ならwキーを押したときだけ保存する。
+  void StartAutoSave(AutoSaver::Poster poster, std::chrono::seconds interval);
+
+  /// @brief ジャーナルへの記録を開始する。以降の編集は全てジャーナルに追記される。
+  /// @param path ジャーナルのファイルのパス。
+  /// @param truncate trueなら既存の記録を捨てる。falseなら続きに追記する。
+  /// @return 開始できたらtrue。
+  bool StartJournal(const std::string& path, bool truncate);
+
+  /// @brief ジャーナルへの記録を終了する。
+  /// @param remove trueならジャーナルのファイルを削除する。
+  void StopJournal(bool remove);
+
+  /// @brief ジャーナルの記録を順にドキュメントへ適用する。履歴には残らない。
+  /// @param records ジャーナルの記録。
+  /// @return 適用できた記録の数。
+  size_t ReplayJournal(std::vector<json> records);
+
  private:
   /* レイアウト & レンダリング */
   /// @brief メインレイアウトを構築する。
@@ -94,8 +281,10 @@ class JsonEditor {
   /// @brief エディタでEnterが押された時に行う処理。
   void OnEditorEnter();
 
-  /// @brief JSONデータをキーと値で更新する。
-  void UpdateJsonValue(json& parent_node, const std::string& key, const std::string& new_value);
+  /// @brief 入力された文字列をJSONの値にする。JSONとして読めなければ文字列として扱う。
+  /// @param text 入力された文字列。
+  /// @return 変換後の値。
+  json ParseJsonValue(const std::string& text) const;
 
   /* モーダル */
   /// @brief 追加モーダルを構築する。
@@ -138,6 +327,103 @@ class JsonEditor {
   /// @brief 選択中の項目を下に移動する。
   void OnMoveDown();
 
+  /// @brief 移動先を指定するモーダルを構築する。
+  Component BuildMoveModal();
+
+  /// @brief 移動先を指定するモーダルを開く処理。
+  /// @return モーダルを開けたらtrue。開けなかったらfalse。
+  bool OnOpenMoveModal();
+
+  /// @brief 選択中の項目を入力された位置へ1回で移動する。
+  /// 数値ならその位置へ、オブジェクトのキーならそのキーの前か後ろへ移す。
+  /// @param after trueならキーの後ろへ移す。位置を指定したときは使わない。
+  void OnMoveToSubmit(bool after);
+
+  /* 複数選択 & 一括操作 */
+  /// @brief カーソル位置の項目の選択を切り替える。
+  /// @return 切り替えられたらtrue。
+  bool ToggleSelection();
+
+  /// @brief 最後に選択を切り替えた項目からカーソル位置までを選択する。
+  /// @return 選択できたらtrue。
+  bool SelectRange();
+
+  /// @brief 選択を全て解除する。
+  void ClearSelection();
+
+  /// @brief 操作対象の位置を昇順で得る。選択がなければカーソル位置の項目だけを返す。
+  std::vector<size_t> GetTargetPositions() const;
+
+  /// @brief 選択中の項目を1つずつ移動する。連続した選択はまとまって動く。
+  /// @param direction 移動方向 (-1: up, 1: down)。
+  void MoveSelection(int direction);
+
+  /// @brief 操作対象の項目を複製し、それぞれの直後に挿入する。
+  void OnDuplicate();
+
+  /// @brief 指定した位置の項目をまとめて削除し、1つの履歴にする。
+  /// @param positions 削除する位置。昇順。
+  /// @return 削除した項目の記録。履歴と共有される。
+  std::shared_ptr<std::vector<BulkRecord>> DeleteEntries(const std::vector<size_t>& positions);
+
+  /// @brief オブジェクト内で使われていないキーを得る。使われていれば"_copy"などの接尾辞を付ける。
+  /// @param object 対象のオブジェクト。
+  /// @param key 元のキー。
+  /// @param reserved オブジェクトには無いが、使用済みとして扱うキー。
+  std::string MakeUniqueKey(const json::object_t& object, const std::string& key, const std::unordered_set<std::string>& reserved) const;
+
+  /* クリップボード */
+  /// @brief 操作対象の項目をクリップボードへコピーする。値はドキュメントと共有され、複製されない。
+  void OnYank();
+
+  /// @brief 操作対象の項目をクリップボードへ移して削除する。
+  void OnCut();
+
+  /// @brief クリップボードの項目をカーソル位置の直後へ挿入する。
+  void OnPaste();
+
+  /// @brief クリップボードの内容を入れ替える。古い内容は共有中の値を複製せずに手放す。
+  /// @param records 新しい内容。
+  void SetClipboard(std::vector<BulkRecord> records);
+
+  /// @brief 型変換モーダルを構築する。
+  Component BuildConvertModal();
+
+  /// @brief 型変換モーダルを開く処理。
+  /// @return モーダルを開けたらtrue。開けなかったらfalse。
+  bool OnOpenConvertModal();
+
+  /// @brief 操作対象の値を指定した型へ変換する。
+  /// @param type 変換先の型。数値はnumber_integerで表す。
+  void OnConvertSubmit(json::value_t type);
+
+  /// @brief 値を指定した型へ変換する。
+  /// @param value 変換する値。
+  /// @param type 変換先の型。
+  /// @param[out] out 変換後の値。
+  /// @return 変換できたらtrue。オブジェクト/配列や解釈できない文字列はfalse。
+  bool ConvertValue(const json& value, json::value_t type, json& out) const;
+
+  /// @brief ソートモーダルを構築する。
+  Component BuildSortModal();
+
+  /// @brief ソートモーダルを開く処理。
+  /// @return モーダルを開けたらtrue。開けなかったらfalse。
+  bool OnOpenSortModal();
+
+  /// @brief 現在の階層を並べ替える。配列は値かサブキーの値で、オブジェクトはキーで並べる。
+  /// @param descending trueなら降順。
+  void OnSortSubmit(bool descending);
+
+  /// @brief 現在の階層の配列から重複した要素を取り除く。最初に現れた要素を残す。
+  void OnDedupe();
+
+  /// @brief 配列の中で、前に同一の要素がある要素を探す。ハッシュ値の計算と比較は並列に行う。
+  /// @param array 対象の配列。
+  /// @param[out] removed 重複した要素の位置(昇順)。
+  /// @param[out] sources removedの各要素と同一の、最初に現れた要素の位置。
+  void FindDuplicates(const json::array_t& array, std::vector<uint32_t>& removed, std::vector<uint32_t>& sources) const;
+
   /// @brief 検索モーダルを構築する。
   Component BuildSearchModal();
 
@@ -155,6 +441,50 @@ class JsonEditor {
   /// @brief 検索モーダルで行う処理。
   void OnSearchSubmit();
 
+  /// @brief 検索範囲に対する検索結果を得る。キャッシュが有効ならば再利用する。
+  /// @param query 検索クエリ。
+  /// @param scope 検索範囲のパス。
+  /// @param filter 指定した場合は、走査しながら一致へ至るノードを記録する。
+  /// @return 検索結果。
+  const SearchCacheEntry& GetSearchResults(const std::string& query, const std::vector<std::string>& scope, TreeFilter* filter = nullptr);
+
+  /// @brief ノード自身とその子孫から検索クエリに一致するものを集める。
+  /// @param query 検索クエリ。
+  /// @param node 起点となるノード。
+  /// @param match_key ノードのキーも一致判定の対象にするか。
+  /// @param path ノードへのパス。走査中は共有スタックとして使い、終了時には元に戻る。
+  /// @param[out] hits 一致したものが追加される。
+  /// @param filter 一致へ至るノードを記録するフィルタ。不要ならnullptr。
+  /// @param node_id フィルタ上での起点ノードのID。
+  void CollectSearchHits(const std::string& query, const json& node, bool match_key, std::vector<std::string>& path, std::vector<SearchHit>& hits, TreeFilter* filter, uint32_t node_id) const;
+
+  /// @brief 検索クエリに一致する枝だけをツリーに表示する。
+  void OnFilterSubmit();
+
+  /// @brief フィルタを現在のドキュメントから作り直す。
+  /// @return 一致したノードがあればtrue。
+  bool RebuildFilter();
+
+  /// @brief フィルタ上のノードIDを現在のパスに合わせる。一致しない枝にいる場合はパスを縮める。
+  /// @return フィルタを継続できればtrue。範囲外に出た場合はfalse。
+  bool SyncFilterPath();
+
+  /// @brief フィルタを解除する。
+  void ClearFilter();
+
+  /// @brief 検索範囲内の文字列値を一括で置換する。
+  void OnReplaceSubmit();
+
+  /// @brief サブツリー内で置換対象の文字列値を探し、置換後の値を記録する。ドキュメントは書き換えない。
+  /// @param node 起点となるノード。
+  /// @param path ノードへのパス。走査中は共有スタックとして使い、終了時には元に戻る。
+  /// @param[out] records 置換後の値の記録が追加される。
+  void CollectReplacements(const json& node, std::vector<std::string>& path, std::vector<ReplaceRecord>& records) const;
+
+  /// @brief 置換の記録とドキュメントの値を入れ替える。Undo/Redoの両方で使う。
+  /// @param records 置換の記録。
+  void SwapReplaceRecords(std::vector<ReplaceRecord>& records);
+
   /// @brief 検索結果を選択したときの処理。
   void OnSearchResultEnter();
 
@@ -175,48 +505,122 @@ class JsonEditor {
   void PerformRedo();
 
   /// @brief Undo/Redo後に画面の状態を復元する。
-  /// @param action 復元する操作。
-  void RestoreView(const EditAction& action);
+  /// @param view 復元する表示位置。無くなったノードは、残っている祖先まで遡る。
+  void RestoreView(const HistoryView& view);
+
+  /// @brief 実行された操作をジャーナルに記録する。
+  /// ログ上の操作はそのまま、関数で表した操作は変更されたサブツリーの値で記録する。
+  /// @param op ログ上の操作。関数で表した操作ではnullptr。
+  /// @param undo 逆操作を行ったか。
+  void JournalEdit(const EditOp* op, bool undo);
+
+  /// @brief 保存を依頼する内容を作る。ドキュメントは構造を共有して複製し、変更箇所は依頼へ移す。
+  /// ジャーナルには保存の開始を記録し、一時ファイルを書き終えたら記録するよう依頼に持たせる。
+  AutoSaver::Snapshot TakeSnapshot();
+
+  /// @brief 変更があるか前回の保存が失敗していれば、裏での保存を依頼する。
+  /// @return 依頼したらtrue。
+  bool RequestSave();
+
+  /// @brief ステータスバーに表示する保存の状態。
+  Element RenderSaveStatus() const;
+
+  /// @brief ジャーナルへの記録をやめていれば、ステータスバーに表示する警告。
+  Element RenderJournalStatus() const;
+
+  /// @brief 実行された操作で移った状態をタイムラインに記録する。
+  /// @param op ログ上の操作。関数で表した操作ではnullptr。
+  /// @param undo 逆操作を行ったか。
+  /// @param view 変更のあった位置。
+  void RecordTimeline(const EditOp* op, bool undo, const HistoryView& view);
+
+  /// @brief タイムラインの記録を、Undo履歴が使っていない分の上限に収める。
+  void EvictTimeline();
+
+  /// @brief ログ上の操作でドキュメントに入った値を探す。
+  /// @param op 実行した操作。
+  /// @param undo 逆操作として実行したか。
+  /// @return 値。取り除く向きの操作や値を持たない操作ではnullptr。
+  const json* FindAppliedValue(const EditOp& op, bool undo) const;
+
+  /// @brief 履歴の枝を選ぶモーダルを構築する。
+  Component BuildBranchModal();
+
+  /// @brief 履歴の枝を選ぶモーダルを開く処理。
+  /// @return モーダルを開けたらtrue。開けなかったらfalse。
+  bool OnOpenBranchModal();
+
+  /// @brief 選んだ枝の先端へドキュメントを切り替える。切り替えもUndoできる。
+  void OnBranchSubmit();
+
+  /// @brief ドキュメント全体を入れ替える。Undo/Redoの両方で使う。
+  /// @param other 入れ替える値。元のドキュメントが入る。
+  void SwapDocument(json& other);
+
+  /// @brief タイムラインをたどるモーダルを構築する。
+  Component BuildTimelineModal();
+
+  /// @brief タイムラインをたどるモーダルを開く処理。開いている間、ドキュメントは選んだ時点の状態になる。
+  /// @return モーダルを開けたらtrue。開けなかったらfalse。
+  bool OnOpenTimelineModal();
+
+  /// @brief タイムラインの時点へ移る。
+  /// @param step 時点の番号。
+  void SeekTimeline(int step);
+
+  /// @brief タイムラインのモーダルを閉じる。
+  /// @param restore trueなら表示中の時点の状態をドキュメントに残す。残した状態もUndoできる。
+  void OnTimelineClose(bool restore);
+
+  /// @brief 履歴のログ上の操作を実行する。
+  /// @param op 実行する操作。
+  /// @param undo trueなら逆操作を行う。
+  /// @return 実行後に表示する位置。
+  HistoryView ApplyEditOp(const EditOp& op, bool undo);
 
   // Undo/Redo用のアクション実装
   /// @brief 値を編集する。
   /// @param path 親ノードへのパス。
   /// @param key 編集対象のキー。
   /// @param value 設定する値。
-  void ExecuteEditValue(const std::vector<std::string>& path, const std::string& key, const json& value);
+  /// @return 置き換えられた元の値。
+  json ExecuteEditValue(const std::vector<std::string>& path, const std::string& key, json value);
 
   /// @brief キーと値のペアを追加する。
   /// @param path 親ノードへのパス。
   /// @param key 追加するキー。
   /// @param value 追加する値。
-  void ExecuteAddKey(const std::vector<std::string>& path, const std::string& key, const json& value);
+  void ExecuteAddKey(const std::vector<std::string>& path, const std::string& key, json value);
 
   /// @brief キーを削除する。
   /// @param path 親ノードへのパス。
   /// @param key 削除するキー。
-  void ExecuteRemoveKey(const std::vector<std::string>& path, const std::string& key);
+  /// @return 削除した値。
+  json ExecuteRemoveKey(const std::vector<std::string>& path, const std::string& key);
 
   /// @brief 配列に要素を追加する。
   /// @param path 配列へのパス。
   /// @param value 追加する値。
-  void ExecuteAddArrayElement(const std::vector<std::string>& path, const json& value);
+  void ExecuteAddArrayElement(const std::vector<std::string>& path, json value);
 
   /// @brief 配列の最後の要素を削除する。
   /// @param path 配列へのパス。
-  void ExecuteRemoveLastArrayElement(const std::vector<std::string>& path);
+  /// @return 削除した値。
+  json ExecuteRemoveLastArrayElement(const std::vector<std::string>& path);
 
   /// @brief 配列の指定位置に要素を挿入する。
   /// @param path 配列へのパス。
   /// @param index 挿入するインデックス。
   /// @param value 挿入する値。
-  void ExecuteInsertArrayElement(const std::vector<std::string>& path, int index, const json& value);
+  void ExecuteInsertArrayElement(const std::vector<std::string>& path, int index, json value);
 
   /// @brief 配列の指定位置の要素を削除する。
   /// @param path 配列へのパス。
   /// @param index 削除するインデックス。
-  void ExecuteRemoveArrayElement(const std::vector<std::string>& path, int index);
+  /// @return 削除した値。
+  json ExecuteRemoveArrayElement(const std::vector<std::string>& path, int index);
 
-  /// @brief キー名を変更する。
+  /// @brief キー名を変更する。キーの位置は保たれる。
   /// @param path 親ノードへのパス。
   /// @param old_key 変更前のキー。
   /// @param new_key 変更後のキー。
@@ -228,13 +632,106 @@ class JsonEditor {
   /// @param direction 移動方向 (-1: up, 1: down)。
   void ExecuteMoveKey(const std::vector<std::string>& path, const std::string& key, int direction);
 
+  /// @brief キーを別のキーの直前へ移動する。リストの付け替えだけで行う。
+  /// @param path 親ノードへのパス。
+  /// @param key 移動するキー。
+  /// @param before_key このキーの直前へ移す。無ければ末尾へ移す。
+  void ExecuteMoveKeyBefore(const std::vector<std::string>& path, const std::string& key, const std::optional<std::string>& before_key);
+
+  /// @brief 配列の要素を別の位置へ移動する。間の要素は1つずつずれる。
+  /// @param path 配列へのパス。
+  /// @param from 移動する要素の位置。
+  /// @param to 移動後の位置。
+  void ExecuteMoveElement(const std::vector<std::string>& path, size_t from, size_t to);
+
+  /// @brief 指定位置の要素をまとめて取り除く。残りの要素は1回の走査で詰める。
+  /// @param path 親ノードへのパス。
+  /// @param positions 取り除く位置(昇順)。
+  /// @return 取り除いた要素。ExecuteInsertEntriesに渡すと元に戻る。
+  std::vector<BulkRecord> ExecuteRemoveEntries(const std::vector<std::string>& path, const std::vector<size_t>& positions);
+
+  /// @brief 記録した位置へ要素をまとめて挿入する。1回の走査で行う。
+  /// @param path 親ノードへのパス。
+  /// @param records 挿入する要素。位置は挿入後の位置(昇順)で、値はドキュメントへ移される。
+  void ExecuteInsertEntries(const std::vector<std::string>& path, std::vector<BulkRecord>& records);
+
+  /// @brief 隣り合う要素の入れ替えを順に行う。
+  /// @param path 親ノードへのパス。
+  /// @param swaps 入れ替える位置。各位置の要素とその次の要素を入れ替える。
+  /// @param reverse trueなら逆順に行う。同じ列を逆順に適用すると元に戻る。
+  void ExecuteSwapEntries(const std::vector<std::string>& path, const std::vector<size_t>& swaps, bool reverse);
+
+  /// @brief 記録の値とドキュメントの値を入れ替える。Undo/Redoの両方で使う。
+  /// @param path 親ノードへのパス。
+  /// @param records 入れ替える値。位置は昇順。
+  void ExecuteSwapValues(const std::vector<std::string>& path, std::vector<BulkRecord>& records);
+
+  /// @brief 要素を並べ替える。要素はコピーせずに移す。
+  /// @param path 親ノードへのパス。
+  /// @param order 並べ替え後の各位置に置く、並べ替え前の位置。
+  /// @param inverse trueなら逆の並べ替えを行う。同じ列で逆に適用すると元に戻る。
+  void ExecutePermuteEntries(const std::vector<std::string>& path, const std::vector<uint32_t>& order, bool inverse);
+
+  /// @brief 配列から重複した要素を取り除く。
+  /// @param path 配列へのパス。
+  /// @param removed 取り除く位置(昇順)。
+  void ExecuteRemoveDuplicates(const std::vector<std::string>& path, const std::vector<uint32_t>& removed);
+
+  /// @brief 取り除いた重複を元の位置へ戻す。値は残した要素から作るため、記録には位置だけを持つ。
+  /// @param path 配列へのパス。
+  /// @param removed 取り除いた位置(昇順)。
+  /// @param sources removedの各要素と同一の、残した要素の取り除く前の位置。
+  void ExecuteRestoreDuplicates(const std::vector<std::string>& path, const std::vector<uint32_t>& removed, const std::vector<uint32_t>& sources);
+
+  /// @brief サブツリーが変更されたことを記録する。
+  /// @param path 変更されたサブツリーへのパス。
+  void MarkModified(const std::vector<std::string>& path);
+
+  /// @brief 親ノードの子が変更されたことを記録する。
+  /// @param path 親ノードへのパス。
+  /// @param key 変更された子のキー。
+  void MarkModified(const std::vector<std::string>& path, const std::string& key);
+
   /* ユーティリティ */
+  /// @brief パスの指すノードが存在するか。
+  /// @param path ルートからのパス。
+  bool HasNode(const std::vector<std::string>& path) const;
+
   /// @brief ルートからのパスに基づいてjsonのノードを得る。
   /// @param root ルートから始まるjsonデータ。
   /// @param path 得るノードまでのパス。
   /// @return jsonノードの参照。
   json& GetNode(json& root, const std::vector<std::string>& path) const;
 
+  /// @brief 読み取り用にノードを得る。共有中のコンテナを複製しない。
+  /// @param path ルートからのパス。
+  /// @return jsonノードの参照。パスが無効ならルート。
+  const json& GetNode(const std::vector<std::string>& path) const;
+
+  /// @brief キーまたはインデックスで子ノードを探す。共有中のコンテナを複製しない。
+  /// @param node 親ノード。
+  /// @param key 子のキー、または配列のインデックス文字列。
+  /// @return 子ノード。見つからなければnullptr。
+  const json* FindChild(const json& node, const std::string& key) const;
+
+  /// @brief 記録が保持する値のおおよそのバイト数を求める。
+  size_t EstimateRecordBytes(const std::vector<BulkRecord>& records) const;
+
+  /// @brief バイト数を"12.3 MB"のような読みやすい文字列にする。
+  std::string FormatBytes(size_t bytes) const;
+
+  /// @brief パスを" > "区切りの文字列にする。
+  /// @param path 対象のパス。
+  /// @return 連結した文字列。
+  std::string JoinPath(const std::vector<std::string>& path) const;
+
+  /// @brief 文字列中の部分文字列を全て置き換える。
+  /// @param str 対象の文字列。
+  /// @param from 置換前の部分文字列。
+  /// @param to 置換後の部分文字列。
+  /// @return 置換後の文字列。
+  std::string ReplaceAll(const std::string& str, const std::string& from, const std::string& to) const;
+
   /// @brief 文字列から改行文字を削除する。
   /// @param str 対象の文字列。
   /// @return 削除後の文字列。
@@ -246,13 +743,18 @@ class JsonEditor {
   /// @brief 現在ツリーで選択されているノードへのポインタとキー/インデックスを得る。
   /// @param[out] out_key 選択されたキー/インデックスが格納される。
   /// @return ノードへのポインタ。選択不可の場合はnullptr。
-  json* GetCurrentSelectedNode(std::string& out_key) const;
+  const json* GetCurrentSelectedNode(std::string& out_key) const;
 
   /// @brief キーのエントリー内インデックスを得る。
   /// @param key 検索するキー。
   /// @return キーのインデックス。なければ-1。
   int GetIndexFromEntries(const std::string& key) const;
 
+  /// @brief 位置がposition以上である最初の項目のエントリー内インデックスを得る。
+  /// @param position 親ノード内での位置。
+  /// @return 項目のインデックス。なければ最後の項目のインデックス。
+  int GetIndexFromPosition(size_t position) const;
+
   /// @brief JSONの型に対応した色を得る。
   /// @param type JSONの型。
   /// @return 色を付けるデコレーター。
@@ -267,6 +769,19 @@ class JsonEditor {
   std::string filename_;
   std::function<void()> on_quit_;
   HistoryManager history_manager_;
+  DocumentVersion document_version_;
+  SearchCache search_cache_;
+  std::unique_ptr<Journal> journal_;
+  // 前回ジャーナルに記録してから変更されたサブツリー
+  std::vector<std::vector<std::string>> journal_paths_;
+  Timeline timeline_;
+  // Undo履歴とタイムラインを合わせた上限。タイムラインには少なくともこの1/kTimelineShareを残す
+  static constexpr size_t kTimelineShare = 4;
+  size_t history_budget_ = HistoryManager::kDefaultBudget;
+  AutoSaver auto_saver_;
+  // 最後に保存を依頼してから変更されたサブツリー
+  DirtySet dirty_set_;
+  uint64_t save_generation_ = 0;
   int selected_tree_item_index_;
   int selected_editor_tab_index_;
   std::vector<std::string> current_path_;
@@ -275,6 +790,13 @@ class JsonEditor {
   std::string viewer_content_;
   std::string editable_content_;
   std::string editor_hint_;
+  // 現在の階層での位置ごとの選択状態
+  std::vector<bool> selection_;
+  std::vector<std::string> selection_path_;
+  size_t selection_anchor_;
+  size_t selection_count_;
+  // ヤンク/カットした項目。値はドキュメントや履歴とコンテナを共有する
+  std::vector<BulkRecord> clipboard_;
 
   /* メインUI */
   MenuOption menu_option_;
@@ -289,22 +811,53 @@ class JsonEditor {
   std::string new_value_;
   std::string rename_key_;
   std::string search_query_;
+  std::string replace_text_;
+  std::string sort_key_;
+  std::string move_target_;
   bool search_from_root_;
   std::vector<std::vector<std::string>> search_results_;
   int current_search_result_index_;
   std::vector<std::string> search_result_labels_;
+  int branch_index_;
+  std::vector<std::string> branch_labels_;
+  int timeline_step_;
+  int timeline_last_;
+  int timeline_shown_step_;
+  // タイムラインを開く前のドキュメントと表示位置。ドキュメントと構造を共有する
+  json timeline_present_;
+  HistoryView timeline_present_view_;
+  DirtySet timeline_present_dirty_set_;
+  TreeFilter tree_filter_;
+  bool filter_active_;
+  bool filter_stale_;
+  std::string filter_query_;
+  std::vector<std::string> filter_scope_;
+  std::vector<std::string> filter_id_path_;
+  std::vector<uint32_t> filter_ids_;
   MenuOption search_menu_option_;
   Component add_key_input_;
   Component add_value_input_;
   Component rename_key_input_;
   Component search_input_;
   Component search_from_root_checkbox_;
+  Component replace_input_;
+  Component sort_key_input_;
+  Component move_target_input_;
+  Component replace_button_;
+  Component filter_button_;
   Component search_results_menu_;
+  Component branch_menu_;
+  Component timeline_slider_;
   Component main_layout_;
   Component add_modal_;
   Component delete_modal_;
   Component rename_modal_;
   Component search_modal_;
   Component help_modal_;
+  Component convert_modal_;
+  Component sort_modal_;
+  Component move_modal_;
+  Component branch_modal_;
+  Component timeline_modal_;
   Component modal_container_;
 };
@@ -1,9 +1,161 @@
 #pragma once
 
 #include <nlohmann/json.hpp>
-#include "fifo_map.hpp"
-#include <map>
-template<class K, class V, class dummy_compare, class A>
-using fifo_map = nlohmann::fifo_map<K, V, nlohmann::fifo_map_compare<K>, A>;
+#include "gap_array.hpp"
+#include "ordered_object.hpp"
 
-using ordered_json = nlohmann::basic_json<fifo_map>;
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+using ordered_json = nlohmann::basic_json<OrderedObject, GapArray>;
+
+/// @brief 値を破棄する。他の値と共有しているオブジェクト/配列は複製せずに参照だけを手放す。
+/// basic_jsonの破棄は子を取り出すために非constな操作を行うため、共有中の部分を一度複製してしまう。
+/// 共有している可能性のある大きな値はこれで破棄する。
+/// @param value 破棄する値。nullになる。
+inline void ReleaseJson(ordered_json& value) {
+  std::vector<ordered_json*> stack{&value};
+  while (!stack.empty()) {
+    ordered_json* node = stack.back();
+    stack.pop_back();
+    if (node->is_array()) {
+      auto& array = node->get_ref<ordered_json::array_t&>();
+      if (array.IsShared()) {
+        array.clear();
+        continue;
+      }
+      for (auto& child : array) stack.push_back(&child);
+    } else if (node->is_object()) {
+      auto& object = node->get_ref<ordered_json::object_t&>();
+      if (object.IsShared()) {
+        object.clear();
+        continue;
+      }
+      for (auto& item : object) stack.push_back(&item.second);
+    }
+  }
+  value = nullptr;
+}
+
+/// @brief 値が保持しているおおよそのバイト数を求める。
+/// 他の値と共有しているオブジェクト/配列は、この値を捨てても解放されないため数えない。
+/// @param value 対象の値。
+inline size_t EstimateJsonBytes(const ordered_json& value) {
+  size_t bytes = 0;
+  std::vector<const ordered_json*> stack{&value};
+  while (!stack.empty()) {
+    const ordered_json& node = *stack.back();
+    stack.pop_back();
+    bytes += sizeof(ordered_json);
+    if (node.is_object()) {
+      const auto& object = node.get_ref<const ordered_json::object_t&>();
+      if (object.IsShared()) continue;
+      for (const auto& [key, child] : object) {
+        // キーとリストのノード、ハッシュ索引の分
+        bytes += sizeof(key) + key.capacity() + 4 * sizeof(void*);
+        stack.push_back(&child);
+      }
+    } else if (node.is_array()) {
+      const auto& array = node.get_ref<const ordered_json::array_t&>();
+      if (array.IsShared()) continue;
+      bytes += (array.capacity() - array.size()) * sizeof(ordered_json);
+      for (const auto& child : array) {
+        stack.push_back(&child);
+      }
+    } else if (node.is_string()) {
+      bytes += node.get_ref<const std::string&>().capacity();
+    }
+  }
+  return bytes;
+}
+
+/// @brief 値の構造からハッシュ値を求める。等しい値は同じハッシュ値になる。
+/// nlohmannのstd::hashは非constな走査で共有中のコンテナを複製するため、複数のスレッドから使えない。
+/// こちらはコンテナにconstでのみ触れるため、同じ値を複数のスレッドから同時に読んでよい。
+/// @param value 対象の値。
+inline size_t HashJson(const ordered_json& value) {
+  size_t seed = 0;
+  auto mix = [&seed](size_t hash) {
+    seed ^= hash + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+  };
+  std::vector<const ordered_json*> stack{&value};
+  while (!stack.empty()) {
+    const ordered_json& node = *stack.back();
+    stack.pop_back();
+    // 整数と浮動小数点数は値が同じなら等しいため、数値は型を区別しない
+    mix(node.is_number() ? 0xff : static_cast<size_t>(node.type()));
+    switch (node.type()) {
+      case ordered_json::value_t::object:
+        mix(node.size());
+        for (const auto& [key, child] : node.get_ref<const ordered_json::object_t&>()) {
+          mix(std::hash<std::string>{}(key));
+          stack.push_back(&child);
+        }
+        break;
+      case ordered_json::value_t::array:
+        mix(node.size());
+        for (const auto& child : node.get_ref<const ordered_json::array_t&>()) {
+          stack.push_back(&child);
+        }
+        break;
+      case ordered_json::value_t::string:
+        mix(std::hash<std::string>{}(node.get_ref<const std::string&>()));
+        break;
+      case ordered_json::value_t::boolean:
+        mix(node.get<bool>());
+        break;
+      case ordered_json::value_t::number_integer:
+      case ordered_json::value_t::number_unsigned:
+      case ordered_json::value_t::number_float:
+        mix(std::hash<double>{}(node.get<double>()));
+        break;
+      default:
+        break;
+    }
+  }
+  return seed;
+}
+
+/// @brief 2つの値が型まで含めて同一か。
+/// operator==は1と1.0や0.0と-0.0を等しいとみなすが、こちらは保存したときの表現まで一致する場合だけtrueを返す。
+/// コンテナにはconstでのみ触れるため、複数のスレッドから同時に使ってよい。
+inline bool IdenticalJson(const ordered_json& lhs, const ordered_json& rhs) {
+  std::vector<std::pair<const ordered_json*, const ordered_json*>> stack{{&lhs, &rhs}};
+  while (!stack.empty()) {
+    auto [left, right] = stack.back();
+    stack.pop_back();
+    if (left->type() != right->type()) return false;
+    switch (left->type()) {
+      case ordered_json::value_t::object: {
+        const auto& left_object = left->get_ref<const ordered_json::object_t&>();
+        const auto& right_object = right->get_ref<const ordered_json::object_t&>();
+        if (left_object.size() != right_object.size()) return false;
+        for (auto l = left_object.begin(), r = right_object.begin(); l != left_object.end(); ++l, ++r) {
+          if (l->first != r->first) return false;
+          stack.push_back({&l->second, &r->second});
+        }
+        break;
+      }
+      case ordered_json::value_t::array: {
+        const auto& left_array = left->get_ref<const ordered_json::array_t&>();
+        const auto& right_array = right->get_ref<const ordered_json::array_t&>();
+        if (left_array.size() != right_array.size()) return false;
+        for (size_t i = 0; i < left_array.size(); ++i) {
+          stack.push_back({&left_array[i], &right_array[i]});
+        }
+        break;
+      }
+      case ordered_json::value_t::number_float:
+        if (std::bit_cast<uint64_t>(left->get<double>()) != std::bit_cast<uint64_t>(right->get<double>())) return false;
+        break;
+      default:
+        if (*left != *right) return false;
+        break;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,137 @@
+#include "json_writer.hpp"
+
+#include "parallel_writer.hpp"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <fcntl.h>
+#include <memory>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+
+/// @brief シンボリックリンクをたどった先のパス。ファイルが無ければそのまま返す
+std::string ResolveTarget(const std::string& path) {
+  struct stat status;
+  if (::lstat(path.c_str(), &status) != 0 || !S_ISLNK(status.st_mode)) return path;
+  char resolved[PATH_MAX];
+  return ::realpath(path.c_str(), resolved) ? std::string(resolved) : path;
+}
+
+std::string DirectoryOf(const std::string& path) {
+  const size_t slash = path.find_last_of('/');
+  if (slash == std::string::npos) return ".";
+  if (slash == 0) return "/";
+  return path.substr(0, slash);
+}
+
+std::string ErrorText(const std::string& action, int error) {
+  return action + ": " + std::generic_category().message(error);
+}
+
+}  // namespace
+
+FileOutputAdapter::FileOutputAdapter(int fd, std::function<void(size_t bytes)> on_progress)
+  : fd_(fd), on_progress_(std::move(on_progress)) {
+  buffer_.reserve(kBufferSize);
+}
+
+void FileOutputAdapter::write_character(char c) {
+  if (buffer_.size() == kBufferSize) Flush();
+  buffer_.push_back(c);
+}
+
+void FileOutputAdapter::write_characters(const char* s, std::size_t length) {
+  if (buffer_.size() + length > kBufferSize) {
+    Flush();
+    // バッファより大きい文字列はそのまま書く
+    if (length > kBufferSize) {
+      WriteAll(s, length);
+      return;
+    }
+  }
+  buffer_.insert(buffer_.end(), s, s + length);
+}
+
+void FileOutputAdapter::Flush() {
+  WriteAll(buffer_.data(), buffer_.size());
+  buffer_.clear();
+}
+
+void FileOutputAdapter::WriteAll(const char* data, size_t size) {
+  const size_t total = size;
+  while (size > 0) {
+    const ssize_t result = ::write(fd_, data, size);
+    if (result < 0) {
+      if (errno == EINTR) continue;
+      throw std::system_error(errno, std::generic_category(), "write");
+    }
+    data += result;
+    size -= result;
+  }
+  if (on_progress_ && total > 0) on_progress_(total);
+}
+
+bool ReplaceFile(const std::string& path, const std::function<void(int fd)>& write, std::string& error, const WriteHooks& hooks) {
+  const std::string target = ResolveTarget(path);
+  const std::string directory = DirectoryOf(target);
+  // renameで置き換えられるよう、一時ファイルは同じディレクトリに作る
+  std::string temp_path = target + ".tmp-XXXXXX";
+  const int fd = ::mkstemp(temp_path.data());
+  if (fd < 0) {
+    error = ErrorText("Could not create " + temp_path, errno);
+    return false;
+  }
+  auto fail = [&](const std::string& message) {
+    ::close(fd);
+    ::unlink(temp_path.c_str());
+    error = message;
+    return false;
+  };
+  // mkstempは0600で作るため、元のファイルの権限に揃える
+  struct stat status;
+  const mode_t mode = ::stat(target.c_str(), &status) == 0 ? (status.st_mode & 07777) : 0644;
+  ::fchmod(fd, mode);
+  try {
+    write(fd);
+    if (hooks.on_written) hooks.on_written(fd);
+  } catch (const std::system_error& e) {
+    return fail(ErrorText("Could not write " + temp_path, e.code().value()));
+  } catch (const std::exception& e) {
+    return fail(e.what());
+  }
+  if (::fsync(fd) != 0) return fail(ErrorText("Could not sync " + temp_path, errno));
+  if (::close(fd) != 0) {
+    const int close_error = errno;
+    ::unlink(temp_path.c_str());
+    error = ErrorText("Could not close " + temp_path, close_error);
+    return false;
+  }
+  if (::rename(temp_path.c_str(), target.c_str()) != 0) {
+    const int rename_error = errno;
+    ::unlink(temp_path.c_str());
+    error = ErrorText("Could not replace " + target, rename_error);
+    return false;
+  }
+  // 置き換えたこと自体を永続化する
+  const int directory_fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (directory_fd >= 0) {
+    ::fsync(directory_fd);
+    ::close(directory_fd);
+  }
+  return true;
+}
+
+bool WriteJsonFile(const ordered_json& value, const std::string& path, int indent, std::string& error, const WriteHooks& hooks) {
+  return ReplaceFile(path, [&](int fd) {
+    if (WriteJsonInParallel(value, fd, indent, hooks.on_progress)) return;
+    auto adapter = std::make_shared<FileOutputAdapter>(fd, hooks.on_progress);
+    nlohmann::detail::serializer<ordered_json> serializer(adapter, ' ');
+    serializer.dump(value, indent >= 0, false, indent >= 0 ? indent : 0);
+    adapter->Flush();
+  }, error, hooks);
+}
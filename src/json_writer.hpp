@@ -0,0 +1,61 @@
+#pragma once
+
+#include "json_types.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/// @brief 保存の途中で呼ばれる関数。どちらも保存を行うスレッドで呼ばれる。
+struct WriteHooks {
+  /// @brief ファイルへ書くたびに、書いたバイト数を渡して呼ばれる。
+  std::function<void(size_t bytes)> on_progress;
+  /// @brief 一時ファイルへ全て書いた後、置き換える前に呼ばれる。例外を投げれば保存は失敗する。
+  std::function<void(int fd)> on_written;
+};
+
+/// @brief シリアライザの出力をバッファに溜め、一杯になるたびにファイルへ書く出力先。
+/// 書き込みに失敗したらstd::system_errorを投げる。
+class FileOutputAdapter : public nlohmann::detail::output_adapter_protocol<char> {
+ public:
+  static constexpr size_t kBufferSize = 4 * 1024 * 1024;
+
+  /// @param fd 書き込み先。
+  /// @param on_progress ファイルへ書くたびに、書いたバイト数を渡して呼ばれる。
+  explicit FileOutputAdapter(int fd, std::function<void(size_t bytes)> on_progress = nullptr);
+
+  void write_character(char c) override;
+
+  void write_characters(const char* s, std::size_t length) override;
+
+  /// @brief 溜まっている出力を全てファイルへ書く。
+  void Flush();
+
+ private:
+  void WriteAll(const char* data, size_t size);
+
+  int fd_;
+  std::function<void(size_t bytes)> on_progress_;
+  std::vector<char> buffer_;
+};
+
+/// @brief ファイルを原子的に置き換える。
+/// 同じディレクトリの一時ファイルへ書き、fsyncしてから元のファイルと置き換える。途中で失敗しても元のファイルはそのまま残る。
+/// @param path 置き換えるファイルのパス。シンボリックリンクならリンク先を置き換える。
+/// @param write 一時ファイルへ内容を書く関数。失敗したら例外を投げる。
+/// @param[out] error 失敗した理由。
+/// @param hooks 書き終えたときに呼ぶ関数。
+/// @return 置き換えられたらtrue。
+bool ReplaceFile(const std::string& path, const std::function<void(int fd)>& write, std::string& error, const WriteHooks& hooks = {});
+
+/// @brief JSONをファイルへ原子的に保存する。
+/// 直列化した文字列全体は作らず、書き込みバッファを通して一時ファイルへ直接書き出すため、
+/// 保存中に増えるメモリはバッファの分だけで済む。大きな値はWriteJsonInParallelで複数のスレッドに分けて直列化する。
+/// @param value 保存する値。constでのみ触れるため、構造を共有する複製を別のスレッドから保存してもよい。
+/// @param path 保存先のパス。
+/// @param indent インデントの幅。負なら改行しない。
+/// @param[out] error 失敗した理由。
+/// @param hooks 途中経過を受け取る関数。
+/// @return 保存できたらtrue。
+bool WriteJsonFile(const ordered_json& value, const std::string& path, int indent, std::string& error, const WriteHooks& hooks = {});
@@ -1,19 +1,72 @@
+#include "journal.hpp"
 #include "json_editor.hpp"
 #include "json_types.hpp"
 
+#include <cctype>
+#include <cstdint>
+#include <stdexcept>
 #include <string>
 #include <iostream>
 #include <fstream>
 
+namespace {
+
+// 自動保存の間隔の上限。1日
+constexpr long kMaxAutosaveSeconds = 24 * 60 * 60;
+
+}  // namespace
+
 int main(int argc, char* argv[]) {
-  if (argc < 2) {
-    std::cerr << "Usage: " << argv[0] << " <filename.json>" << std::endl;
+  // オプションとファイル名を分ける
+  size_t history_budget = HistoryManager::kDefaultBudget;
+  long autosave_seconds = 60;
+  const char* filename = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if ((arg == "--history-mb" || arg == "--autosave-sec") && i + 1 >= argc) {
+      std::cerr << "Error: Missing value for " << arg << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (arg == "--history-mb") {
+      const std::string value = argv[++i];
+      try {
+        // stoullは負の数も受け付けて折り返すため、数字で始まらない値は弾く
+        if (value.empty() || !std::isdigit(static_cast<unsigned char>(value[0]))) throw std::invalid_argument("not a number");
+        size_t length = 0;
+        const unsigned long long megabytes = std::stoull(value, &length);
+        if (length != value.size()) throw std::invalid_argument("trailing characters");
+        if (megabytes > SIZE_MAX / (1024 * 1024)) throw std::out_of_range("too large");
+        history_budget = static_cast<size_t>(megabytes) * 1024 * 1024;
+      } catch (...) {
+        std::cerr << "Error: Invalid value for --history-mb: " << value << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if (arg == "--autosave-sec") {
+      const std::string value = argv[++i];
+      try {
+        // stolは末尾の余分な文字を無視するため、数字だけからなる値に限る
+        if (value.empty() || !std::isdigit(static_cast<unsigned char>(value[0]))) throw std::invalid_argument("not a number");
+        size_t length = 0;
+        autosave_seconds = std::stol(value, &length);
+        if (length != value.size()) throw std::invalid_argument("trailing characters");
+        // 長すぎる間隔は次の時刻を求めるときにナノ秒で桁あふれする
+        if (autosave_seconds > kMaxAutosaveSeconds) throw std::out_of_range("too large");
+      } catch (...) {
+        std::cerr << "Error: Invalid value for --autosave-sec: " << value << " (0-" << kMaxAutosaveSeconds << ")" << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else {
+      filename = argv[i];
+    }
+  }
+  if (!filename) {
+    std::cerr << "Usage: " << argv[0] << " [--history-mb <MB>] [--autosave-sec <seconds>] <filename.json>" << std::endl;
     return EXIT_FAILURE;
   }
 
-  std::ifstream input_file(argv[1]);
+  std::ifstream input_file(filename);
   if (!input_file) {
-    std::cerr << "Error: Could not open file " << argv[1] << std::endl;
+    std::cerr << "Error: Could not open file " << filename << std::endl;
     return EXIT_FAILURE;
   }
 
@@ -26,28 +79,48 @@ int main(int argc, char* argv[]) {
   }
   input_file.close(); 
 
+  // 前回保存せずに終了していれば、ジャーナルに残った編集を適用するか尋ねる
+  const std::string journal_path = std::string(filename) + ".journal";
+  // 編集中に保存していれば、保存したファイルに含まれる記録は除かれる
+  std::vector<ordered_json> journal_records = Journal::ReadRecords(journal_path, FileStamp::Read(filename));
+  bool replay = false;
+  if (!journal_records.empty()) {
+    std::cout << "Found " << journal_records.size() << " unsaved edit(s) in " << journal_path << ". Replay them? [y/N] " << std::flush;
+    std::string answer;
+    std::getline(std::cin, answer);
+    replay = answer == "y" || answer == "Y";
+  }
+
   auto screen = ScreenInteractive::Fullscreen();
 
-  JsonEditor editor(input_json, argv[1], screen.ExitLoopClosure());
+  JsonEditor editor(input_json, filename, screen.ExitLoopClosure());
+  editor.SetHistoryBudget(history_budget);
+  if (replay) {
+    editor.ReplayJournal(std::move(journal_records));
+  }
+  // 適用しなかった記録は捨てる。適用した記録は元のファイルに対する編集なので、続きを追記する
+  if (!editor.StartJournal(journal_path, !replay)) {
+    std::cerr << "Warning: Could not open journal " << journal_path << std::endl;
+  }
+  editor.StartAutoSave([&screen](std::function<void()> task) {
+    screen.Post(std::move(task));
+    screen.PostEvent(Event::Custom);
+  }, std::chrono::seconds(autosave_seconds));
 
   auto custom_loop = [&] {
     try {
       screen.Loop(editor.GetLayout());
     } catch (...) {}
-    std::cout << "\nSaving changed to " << argv[1] << "..." << std::endl;
-    std::ofstream output_file(argv[1]);
-    if (!output_file) {
-      std::cerr << "Error: Could not open file" << argv[1] << " for writing." << std::endl;
-      return EXIT_FAILURE;
-    }
-    try {
-      output_file << input_json.dump(2);
-      output_file.close();
-      std::cout << "Done." << std::endl;
-    } catch (json::exception& e) {
-      std::cerr << "Error saving JSON: " << e.what() << std::endl;
+    std::cout << "\nSaving changed to " << filename << "..." << std::endl;
+    // 裏で保存中ならそれを待つ。一時ファイルへ書いてから置き換えるため、失敗しても元のファイルは壊れない
+    std::string error;
+    if (!editor.Save(error)) {
+      std::cerr << "Error saving JSON: " << error << std::endl;
       return EXIT_FAILURE;
     }
+    // 保存できた編集はジャーナルから消す
+    editor.StopJournal(true);
+    std::cout << "Done." << std::endl;
     return EXIT_SUCCESS;
   };
   
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <compare>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+/// @brief 挿入順を保つオブジェクト用コンテナ。basic_jsonのObjectTypeとして使う。
+/// 要素は連結リストで保持し、キーからの検索はハッシュ索引で行う。
+/// 要素の移動やキーの変更はリストの付け替えで行うため、値のコピーも他の要素の移動も起きない。
+/// コピーは要素を共有し、非constな操作を行った側が複製を持つ(コピーオンライト)。
+/// 大きなファイルの大半を占める小さなオブジェクトは索引を持たず、キーを先頭から比べて探す。
+template <class Key, class T, class IgnoredLess = std::less<Key>,
+          class Allocator = std::allocator<std::pair<const Key, T>>>
+class OrderedObject {
+ public:
+  using key_type = Key;
+  using mapped_type = T;
+  using value_type = std::pair<const Key, T>;
+  using key_compare = std::less<Key>;
+  using container_type = std::list<value_type>;
+  using iterator = typename container_type::iterator;
+  using const_iterator = typename container_type::const_iterator;
+  using size_type = typename container_type::size_type;
+  using difference_type = typename container_type::difference_type;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+
+  /// @brief 要素数がこれを超えたら索引を作る。
+  static constexpr size_type kIndexThreshold = 8;
+
+  OrderedObject() = default;
+
+  explicit OrderedObject(const Allocator&) {}
+
+  template <class InputIt>
+  OrderedObject(InputIt first, InputIt last, const Allocator& = Allocator()) {
+    insert(first, last);
+  }
+
+  OrderedObject(std::initializer_list<value_type> init, const Allocator& = Allocator()) {
+    insert(init.begin(), init.end());
+  }
+
+  OrderedObject(const OrderedObject& other) = default;
+  OrderedObject(OrderedObject&& other) noexcept = default;
+  OrderedObject& operator=(const OrderedObject& other) = default;
+  OrderedObject& operator=(OrderedObject&& other) noexcept = default;
+
+  iterator begin() { return Mutable().items.begin(); }
+  const_iterator begin() const noexcept { return Shared().items.begin(); }
+  const_iterator cbegin() const noexcept { return Shared().items.cbegin(); }
+  iterator end() { return Mutable().items.end(); }
+  const_iterator end() const noexcept { return Shared().items.end(); }
+  const_iterator cend() const noexcept { return Shared().items.cend(); }
+
+  bool empty() const noexcept { return Shared().items.empty(); }
+  size_type size() const noexcept { return Shared().items.size(); }
+  size_type max_size() const noexcept { return Shared().items.max_size(); }
+
+  /// @brief 全要素を削除する。共有中の要素は複製せずに手放す。
+  void clear() noexcept {
+    if (IsShared()) {
+      impl_.reset();
+    } else if (impl_) {
+      impl_->index.clear();
+      impl_->items.clear();
+    }
+  }
+
+  template <class K, class... Args>
+  std::pair<iterator, bool> emplace(K&& key, Args&&... args) {
+    return EmplaceBefore(end(), Key(std::forward<K>(key)), std::forward<Args>(args)...);
+  }
+
+  std::pair<iterator, bool> insert(const value_type& value) {
+    return EmplaceBefore(end(), Key(value.first), value.second);
+  }
+
+  std::pair<iterator, bool> insert(value_type&& value) {
+    return EmplaceBefore(end(), Key(value.first), std::move(value.second));
+  }
+
+  template <class InputIt>
+  void insert(InputIt first, InputIt last) {
+    for (; first != last; ++first) {
+      insert(*first);
+    }
+  }
+
+  T& operator[](const Key& key) {
+    return EmplaceBefore(end(), Key(key)).first->second;
+  }
+
+  const T& operator[](const Key& key) const {
+    return at(key);
+  }
+
+  T& at(const Key& key) {
+    auto iter = find(key);
+    if (iter == end()) throw std::out_of_range("key not found");
+    return iter->second;
+  }
+
+  const T& at(const Key& key) const {
+    auto iter = find(key);
+    if (iter == end()) throw std::out_of_range("key not found");
+    return iter->second;
+  }
+
+  iterator find(const Key& key) {
+    return Find(Mutable(), KeyView(key));
+  }
+
+  const_iterator find(const Key& key) const {
+    return Find(Shared(), KeyView(key));
+  }
+
+  size_type count(const Key& key) const {
+    return find(key) == cend() ? 0 : 1;
+  }
+
+  size_type erase(const Key& key) {
+    auto iter = find(key);
+    if (iter == end()) return 0;
+    erase(iter);
+    return 1;
+  }
+
+  iterator erase(const_iterator pos) {
+    Impl& impl = Mutable();
+    if (!impl.index.empty()) impl.index.erase(KeyView(pos->first));
+    return impl.items.erase(pos);
+  }
+
+  iterator erase(const_iterator first, const_iterator last) {
+    while (first != last) {
+      first = erase(first);
+    }
+    return Mutable().items.erase(last, last);
+  }
+
+  void swap(OrderedObject& other) noexcept {
+    impl_.swap(other.impl_);
+  }
+
+  /// @brief 要素を他のオブジェクトと共有しているか。
+  bool IsShared() const noexcept {
+    if (!impl_) return false;
+    if (impl_.use_count() > 1) return true;
+    // 他のスレッドが手放した直後でも、そのスレッドでの読み取りを以降の書き換えより前に終わらせる
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return false;
+  }
+
+  /// @brief キーが無ければ指定位置の直前に要素を挿入する。
+  /// @return 挿入した要素(キーが既にあればその要素)と、挿入できたかどうか。
+  template <class... Args>
+  std::pair<iterator, bool> InsertBefore(const_iterator position, Key key, Args&&... args) {
+    return EmplaceBefore(position, std::move(key), std::forward<Args>(args)...);
+  }
+
+  /// @brief 要素を指定位置の直前へ移動する。値はコピーされず、O(1)で完了する。
+  /// @param item 移動する要素。
+  /// @param position 移動先。この要素の直前に置かれる。end()なら末尾。
+  void MoveBefore(const_iterator item, const_iterator position) {
+    if (item == position) return;
+    Impl& impl = Mutable();
+    impl.items.splice(position, impl.items, item);
+  }
+
+  /// @brief 要素のキーを変更する。位置は保たれ、値はコピーされずに移される。
+  /// @param item 変更する要素。
+  /// @param new_key 新しいキー。
+  /// @return 変更後の要素と、変更できたかどうか。キーが既に使われていれば変更せず、その要素を返す。
+  std::pair<iterator, bool> Rename(const_iterator item, Key new_key) {
+    Impl& impl = Mutable();
+    iterator target = impl.items.erase(item, item);
+    if (target->first == new_key) {
+      return {target, true};
+    }
+    iterator found = Find(impl, KeyView(new_key));
+    if (found != impl.items.end()) {
+      return {found, false};
+    }
+    auto renamed = impl.items.emplace(std::next(target), std::piecewise_construct,
+                                      std::forward_as_tuple(std::move(new_key)),
+                                      std::forward_as_tuple(std::move(target->second)));
+    erase(target);
+    if (!impl.index.empty()) impl.index.emplace(KeyView(renamed->first), renamed);
+    return {renamed, true};
+  }
+
+  friend bool operator==(const OrderedObject& lhs, const OrderedObject& rhs) {
+    return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+  }
+
+  friend auto operator<=>(const OrderedObject& lhs, const OrderedObject& rhs) {
+    return std::lexicographical_compare_three_way(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+  }
+
+ private:
+  using key_view = std::basic_string_view<typename Key::value_type>;
+
+  static key_view KeyView(const Key& key) {
+    return key_view(key.data(), key.size());
+  }
+
+  /// @brief 要素の連結リストと、キーからの索引。
+  struct Impl {
+    Impl() = default;
+
+    Impl(const Impl& other) : items(other.items) {
+      if (!other.index.empty()) BuildIndex();
+    }
+
+    void BuildIndex() {
+      index.reserve(items.size());
+      for (auto iter = items.begin(); iter != items.end(); ++iter) {
+        index.emplace(KeyView(iter->first), iter);
+      }
+    }
+
+    container_type items;
+    // キーはitemsの要素を指すため、要素が生きている間だけ有効。
+    // 要素数がkIndexThresholdを超えるまでは空のまま使わない
+    std::unordered_map<key_view, iterator> index;
+  };
+
+  /// @brief キーの要素を探す。索引が無ければ先頭から比べる。
+  template <class ImplType>
+  static auto Find(ImplType& impl, key_view key) -> decltype(impl.items.begin()) {
+    if (impl.index.empty()) {
+      return std::find_if(impl.items.begin(), impl.items.end(),
+                          [&](const value_type& item) { return KeyView(item.first) == key; });
+    }
+    auto found = impl.index.find(key);
+    if (found == impl.index.end()) return impl.items.end();
+    return found->second;
+  }
+
+  /// @brief 読み取り用の要素を得る。空のオブジェクトは共通の空の要素を指す。
+  const Impl& Shared() const noexcept {
+    static const Impl empty;
+    return impl_ ? *impl_ : empty;
+  }
+
+  /// @brief 書き換え用の要素を得る。他と共有していれば複製してから返す。
+  Impl& Mutable() {
+    if (!impl_) impl_ = std::make_shared<Impl>();
+    else if (IsShared()) impl_ = std::make_shared<Impl>(*impl_);
+    return *impl_;
+  }
+
+  /// @brief キーが無ければ指定位置の直前に要素を作る。あれば既存の要素を返す。
+  template <class... Args>
+  std::pair<iterator, bool> EmplaceBefore(const_iterator position, Key&& key, Args&&... args) {
+    Impl& impl = Mutable();
+    iterator found = Find(impl, KeyView(key));
+    if (found != impl.items.end()) {
+      return {found, false};
+    }
+    auto iter = impl.items.emplace(position, std::piecewise_construct,
+                                   std::forward_as_tuple(std::move(key)),
+                                   std::forward_as_tuple(std::forward<Args>(args)...));
+    if (!impl.index.empty()) {
+      impl.index.emplace(KeyView(iter->first), iter);
+    } else if (impl.items.size() > kIndexThreshold) {
+      impl.BuildIndex();
+    }
+    return {iter, true};
+  }
+
+  std::shared_ptr<Impl> impl_;
+};
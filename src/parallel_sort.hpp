@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// @brief タスクを別々のスレッドで同時に実行し、全て終わるまで待つ。
+/// @param task_count タスクの数。0番のタスクは呼び出したスレッドで実行する。
+/// @param task タスクの番号を受け取る関数。
+template <class Task>
+void RunParallel(size_t task_count, const Task& task) {
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < task_count; ++i) {
+    threads.emplace_back(task, i);
+  }
+  if (task_count > 0) task(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+/// @brief 列を並列に安定ソートする。
+/// 区間ごとに別スレッドでソートし、隣り合う区間の併合も並列に行う。
+/// 比較関数は複数のスレッドから同時に呼ばれるため、読み取りだけを行うこと。
+/// @param items ソートする列。
+/// @param less 比較関数。
+template <class T, class Compare>
+void ParallelStableSort(std::vector<T>& items, Compare less) {
+  // 小さすぎる区間はスレッドを立てる方が高くつく
+  constexpr size_t kMinChunkSize = 4096;
+  const size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+  const size_t chunk_count = std::clamp<size_t>(items.size() / kMinChunkSize, 1, thread_count);
+  // 区間の境界。併合するたびに区間の数は半分になる
+  std::vector<size_t> bounds;
+  for (size_t i = 0; i <= chunk_count; ++i) {
+    bounds.push_back(items.size() * i / chunk_count);
+  }
+  RunParallel(chunk_count, [&](size_t i) {
+    std::stable_sort(items.begin() + bounds[i], items.begin() + bounds[i + 1], less);
+  });
+  while (bounds.size() > 2) {
+    RunParallel((bounds.size() - 1) / 2, [&](size_t i) {
+      std::inplace_merge(items.begin() + bounds[2 * i], items.begin() + bounds[2 * i + 1],
+                         items.begin() + bounds[2 * i + 2], less);
+    });
+    std::vector<size_t> merged;
+    for (size_t i = 0; i < bounds.size(); i += 2) {
+      merged.push_back(bounds[i]);
+    }
+    if (merged.back() != bounds.back()) merged.push_back(bounds.back());
+    bounds = std::move(merged);
+  }
+}
@@ -0,0 +1,355 @@
+#include "parallel_writer.hpp"
+
+#include "parallel_sort.hpp"
+
+#include <cerrno>
+#include <climits>
+#include <condition_variable>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/uio.h>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// 1つのチャンクで直列化する量の目安(バイト)
+constexpr size_t kChunkSize = 1024 * 1024;
+// これより小さな値は分けずに1つのチャンクで直列化する
+constexpr size_t kSplitSize = 8 * kChunkSize;
+// 子がこれより多いコンテナは、一部の子だけを見積もる
+constexpr size_t kExactChildren = 256;
+// 見積もる子の間隔
+constexpr size_t kSampleInterval = 256;
+// 書き終えていないチャンクは、スレッドあたりこれだけまで先に直列化しておく
+constexpr size_t kChunksPerThread = 4;
+
+using Serializer = nlohmann::detail::serializer<ordered_json>;
+using ObjectIterator = ordered_json::object_t::const_iterator;
+using ArrayIterator = ordered_json::array_t::const_iterator;
+
+// basic_jsonのイテレーターは非constなbegin()を呼んで共有中のコンテナを複製するため、
+// コンテナにはget_ref<const ...>とそのconst_iteratorでだけ触れる
+const ordered_json& ValueOf(const ordered_json::object_t::value_type& member) { return member.second; }
+const ordered_json& ValueOf(const ordered_json& element) { return element; }
+const std::string* KeyOf(const ordered_json::object_t::value_type& member) { return &member.first; }
+const std::string* KeyOf(const ordered_json&) { return nullptr; }
+
+/// @brief 直列化した大きさの見積もり。limitに達したらそれ以上は数えない
+size_t EstimateSize(const ordered_json& value, size_t limit) {
+  switch (value.type()) {
+    case ordered_json::value_t::object: {
+      const auto& object = value.get_ref<const ordered_json::object_t&>();
+      size_t size = 2;
+      for (auto member = object.begin(); member != object.end() && size < limit; ++member) {
+        size += member->first.size() + 4 + EstimateSize(member->second, limit - size);
+      }
+      return size;
+    }
+    case ordered_json::value_t::array: {
+      const auto& array = value.get_ref<const ordered_json::array_t&>();
+      size_t size = 2;
+      for (auto element = array.begin(); element != array.end() && size < limit; ++element) {
+        size += 1 + EstimateSize(*element, limit - size);
+      }
+      return size;
+    }
+    case ordered_json::value_t::string:
+      return value.get_ref<const ordered_json::string_t&>().size() + 2;
+    default:
+      return 8;
+  }
+}
+
+/// @brief 出力の一部。textの後ろに、コンテナの子の範囲を直列化した結果が続く
+struct Chunk {
+  std::string text;
+  /// @brief 範囲を持つコンテナ。nullptrならtextだけ
+  const ordered_json* container = nullptr;
+  /// @brief コンテナがオブジェクトのときの範囲
+  ObjectIterator first_member;
+  ObjectIterator last_member;
+  /// @brief コンテナが配列のときの範囲
+  ArrayIterator first_element;
+  ArrayIterator last_element;
+  /// @brief 範囲の最初がコンテナの最初の子か
+  bool leading = false;
+  /// @brief コンテナの深さ
+  unsigned int depth = 0;
+  /// @brief 範囲を直列化した大きさの見積もり
+  size_t size = 0;
+};
+
+/// @brief コンテナの子の前に置く区切りとキーを書く
+/// @param key オブジェクトのメンバーのキー。配列の要素ならnullptr。
+void WriteSeparator(Serializer& serializer, std::string& out, const std::string* key, bool leading, bool pretty,
+                    unsigned int indent) {
+  if (!leading) out += ',';
+  if (pretty) {
+    out += '\n';
+    out.append(indent, ' ');
+  }
+  if (key) {
+    serializer.dump(ordered_json(*key), false, false, 0);
+    out += pretty ? ": " : ":";
+  }
+}
+
+/// @brief 値をチャンクへ分ける。
+/// 大きなコンテナの子は、見積もりがkChunkSizeに達するまで隣り合うものを1つの範囲にまとめ、それ自体が大きな子はさらに分ける。
+/// 見積もりのための走査が直列化に比べて無視できるよう、子の多いコンテナではkSampleIntervalごとの子だけを見積もり、
+/// 間の子は直前に見積もった子と同じ大きさとみなす。見積もりが外れても出力は変わらず、チャンクの大きさが偏るだけで済む。
+/// 分けたコンテナの括弧や区切りは、次のチャンクのtextに入れる
+class Planner {
+ public:
+  Planner(bool pretty, unsigned int indent)
+    : pretty_(pretty), indent_(indent),
+      serializer_(std::make_shared<nlohmann::detail::output_string_adapter<char>>(pending_), ' ') {}
+
+  std::vector<Chunk> Run(const ordered_json& root) {
+    Split(root, 0);
+    chunks_.push_back({std::move(pending_)});
+    return std::move(chunks_);
+  }
+
+ private:
+  void Split(const ordered_json& value, unsigned int depth) {
+    if (value.is_object()) {
+      const auto& object = value.get_ref<const ordered_json::object_t&>();
+      pending_ += '{';
+      SplitChildren(value, object.begin(), object.end(), depth);
+      CloseContainer('}', depth);
+    } else {
+      const auto& array = value.get_ref<const ordered_json::array_t&>();
+      pending_ += '[';
+      SplitChildren(value, array.begin(), array.end(), depth);
+      CloseContainer(']', depth);
+    }
+  }
+
+  template <class Iterator>
+  void SplitChildren(const ordered_json& container, Iterator begin, Iterator end, unsigned int depth) {
+    auto first = begin;
+    bool leading = true;
+    size_t size = 0;
+    const bool sample = container.size() > kExactChildren;
+    size_t index = 0;
+    size_t item_size = 0;
+    for (auto child = begin; child != end; ++child, ++index) {
+      const ordered_json& item = ValueOf(*child);
+      if (!sample || index % kSampleInterval == 0) item_size = EstimateSize(item, kSplitSize);
+      if (item_size >= kSplitSize && item.is_structured() && !item.empty()) {
+        AddRange(container, first, child, leading, depth, size);
+        WriteSeparator(serializer_, pending_, KeyOf(*child), child == begin, pretty_, (depth + 1) * indent_);
+        Split(item, depth + 1);
+        first = std::next(child);
+        leading = false;
+        size = 0;
+        continue;
+      }
+      size += item_size;
+      if (size >= kChunkSize) {
+        AddRange(container, first, std::next(child), leading, depth, size);
+        first = std::next(child);
+        leading = false;
+        size = 0;
+      }
+    }
+    AddRange(container, first, end, leading, depth, size);
+  }
+
+  void CloseContainer(char close, unsigned int depth) {
+    if (pretty_) {
+      pending_ += '\n';
+      pending_.append(depth * indent_, ' ');
+    }
+    pending_ += close;
+  }
+
+  template <class Iterator>
+  void AddRange(const ordered_json& container, Iterator first, Iterator last, bool leading, unsigned int depth,
+                size_t size) {
+    if (first == last) return;
+    Chunk chunk{std::move(pending_), &container};
+    if constexpr (std::is_same_v<Iterator, ObjectIterator>) {
+      chunk.first_member = first;
+      chunk.last_member = last;
+    } else {
+      chunk.first_element = first;
+      chunk.last_element = last;
+    }
+    chunk.leading = leading;
+    chunk.depth = depth;
+    chunk.size = size;
+    chunks_.push_back(std::move(chunk));
+    pending_.clear();
+  }
+
+  bool pretty_;
+  unsigned int indent_;
+  // 次のチャンクの先頭に置く括弧や区切り
+  std::string pending_;
+  Serializer serializer_;
+  std::vector<Chunk> chunks_;
+};
+
+/// @brief チャンクを複数のスレッドで直列化し、呼び出したスレッドで順に書く
+class ParallelWriter {
+ public:
+  ParallelWriter(std::vector<Chunk> chunks, int fd, bool pretty, unsigned int indent, size_t thread_count,
+                 const std::function<void(size_t)>& on_progress)
+    : chunks_(std::move(chunks)), fd_(fd), pretty_(pretty), indent_(indent), thread_count_(thread_count),
+      on_progress_(on_progress), formatted_(chunks_.size()) {}
+
+  void Run() {
+    // 0番のタスクは呼び出したスレッドで実行されるため、そこで書く
+    RunParallel(thread_count_ + 1, [this](size_t task) {
+      try {
+        if (task == 0) {
+          Write();
+        } else {
+          Format();
+        }
+      } catch (...) {
+        std::lock_guard lock(mutex_);
+        if (!error_) error_ = std::current_exception();
+        stop_ = true;
+        formatted_condition_.notify_all();
+        written_condition_.notify_all();
+      }
+    });
+    if (error_) std::rethrow_exception(error_);
+  }
+
+ private:
+  void Format() {
+    const size_t window = thread_count_ * kChunksPerThread;
+    while (true) {
+      size_t index;
+      {
+        std::unique_lock lock(mutex_);
+        written_condition_.wait(lock, [&] { return stop_ || next_ == chunks_.size() || next_ < written_ + window; });
+        if (stop_ || next_ == chunks_.size()) return;
+        index = next_++;
+      }
+      FormatChunk(chunks_[index]);
+      {
+        std::lock_guard lock(mutex_);
+        formatted_[index] = true;
+      }
+      formatted_condition_.notify_one();
+    }
+  }
+
+  void FormatChunk(Chunk& chunk) {
+    if (!chunk.container) return;
+    chunk.text.reserve(chunk.text.size() + chunk.size + chunk.size / 4);
+    if (chunk.container->is_object()) {
+      FormatRange(chunk, chunk.first_member, chunk.last_member);
+    } else {
+      FormatRange(chunk, chunk.first_element, chunk.last_element);
+    }
+  }
+
+  template <class Iterator>
+  void FormatRange(Chunk& chunk, Iterator first, Iterator last) {
+    Serializer serializer(std::make_shared<nlohmann::detail::output_string_adapter<char>>(chunk.text), ' ');
+    const unsigned int child_indent = (chunk.depth + 1) * indent_;
+    bool leading = chunk.leading;
+    for (auto child = first; child != last; ++child) {
+      WriteSeparator(serializer, chunk.text, KeyOf(*child), leading, pretty_, child_indent);
+      serializer.dump(ValueOf(*child), pretty_, false, indent_, child_indent);
+      leading = false;
+    }
+  }
+
+  void Write() {
+    std::vector<iovec> vectors;
+    size_t position = 0;
+    while (position < chunks_.size()) {
+      size_t end = position;
+      {
+        std::unique_lock lock(mutex_);
+        formatted_condition_.wait(lock, [&] { return stop_ || formatted_[position]; });
+        if (stop_) return;
+        // 直列化を終えて並んでいるチャンクをまとめて書く
+        while (end < chunks_.size() && formatted_[end] && end - position < IOV_MAX) ++end;
+      }
+      vectors.clear();
+      size_t total = 0;
+      for (size_t i = position; i < end; ++i) {
+        auto& text = chunks_[i].text;
+        if (text.empty()) continue;
+        vectors.push_back({text.data(), text.size()});
+        total += text.size();
+      }
+      WriteVectors(vectors);
+      if (on_progress_ && total > 0) on_progress_(total);
+      for (size_t i = position; i < end; ++i) {
+        std::string().swap(chunks_[i].text);
+      }
+      {
+        std::lock_guard lock(mutex_);
+        written_ = end;
+      }
+      written_condition_.notify_all();
+      position = end;
+    }
+  }
+
+  void WriteVectors(std::vector<iovec>& vectors) {
+    size_t index = 0;
+    while (index < vectors.size()) {
+      const ssize_t result = ::writev(fd_, vectors.data() + index, static_cast<int>(vectors.size() - index));
+      if (result < 0) {
+        if (errno == EINTR) continue;
+        throw std::system_error(errno, std::generic_category(), "writev");
+      }
+      // 途中まで書けたバッファは残りから書き直す
+      size_t rest = result;
+      while (index < vectors.size() && rest >= vectors[index].iov_len) {
+        rest -= vectors[index].iov_len;
+        ++index;
+      }
+      if (rest > 0) {
+        vectors[index].iov_base = static_cast<char*>(vectors[index].iov_base) + rest;
+        vectors[index].iov_len -= rest;
+      }
+    }
+  }
+
+  std::vector<Chunk> chunks_;
+  int fd_;
+  bool pretty_;
+  unsigned int indent_;
+  size_t thread_count_;
+  const std::function<void(size_t)>& on_progress_;
+
+  std::mutex mutex_;
+  std::condition_variable formatted_condition_;
+  std::condition_variable written_condition_;
+  // 以下はmutex_で守る
+  std::vector<bool> formatted_;
+  size_t next_ = 0;
+  size_t written_ = 0;
+  bool stop_ = false;
+  std::exception_ptr error_;
+};
+
+}  // namespace
+
+bool WriteJsonInParallel(const ordered_json& value, int fd, int indent, const std::function<void(size_t bytes)>& on_progress) {
+  const size_t thread_count = std::thread::hardware_concurrency();
+  if (thread_count < 2 || !value.is_structured() || EstimateSize(value, kSplitSize) < kSplitSize) return false;
+  const bool pretty = indent >= 0;
+  const unsigned int step = pretty ? indent : 0;
+  std::vector<Chunk> chunks = Planner(pretty, step).Run(value);
+  ParallelWriter(std::move(chunks), fd, pretty, step, thread_count, on_progress).Run();
+  return true;
+}
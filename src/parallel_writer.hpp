@@ -0,0 +1,18 @@
+#pragma once
+
+#include "json_types.hpp"
+
+#include <cstddef>
+#include <functional>
+
+/// @brief 大きなJSONを複数のスレッドで直列化してファイルへ書く。
+/// 大きなコンテナを子の並びに沿ってチャンクに分け、各チャンクを別々のスレッドでそれぞれのバッファへ直列化し、
+/// 出来上がったバッファを先頭から順にwritevでまとめて書く。出力はdumpと同じ内容になる。
+/// 書き終えていないバッファの数に上限を設けるため、保存中に増えるメモリはスレッド数に比例する分だけで済む。
+/// 書き込みに失敗したらstd::system_errorを、直列化できない値ならnlohmannの例外を投げる。
+/// @param value 書く値。constでのみ触れ、複数のスレッドから同時に読む。
+/// @param fd 書き込み先。
+/// @param indent インデントの幅。負なら改行しない。
+/// @param on_progress ファイルへ書くたびに、書いたバイト数を渡して呼ばれる。呼び出したスレッドで呼ばれる。
+/// @return 値が小さい、またはスレッドを使えず分ける意味が無ければ何も書かずにfalse。
+bool WriteJsonInParallel(const ordered_json& value, int fd, int indent, const std::function<void(size_t bytes)>& on_progress);
@@ -0,0 +1,324 @@
+#include "patch_writer.hpp"
+
+#include "json_writer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// これより短い範囲はバッファへ写す。長い範囲はcopy_file_rangeで写す
+constexpr size_t kCopyRangeThreshold = 64 * 1024;
+// 途中経過を知らせるため、copy_file_rangeは一度にこれだけずつ写す
+constexpr size_t kCopyChunkSize = 64 * 1024 * 1024;
+
+/// @brief 元のファイルと値の構造が食い違ったことを表す
+class LayoutMismatch : public std::runtime_error {
+ public:
+  LayoutMismatch() : std::runtime_error("The file layout does not match the document") {}
+};
+
+/// @brief 元のファイルを走査しながら、変更箇所だけを直列化した内容を書く。
+class Patcher {
+ public:
+  Patcher(const char* data, size_t size, int source_fd, int fd, const DirtySet& dirty, const std::function<void(size_t)>& on_progress)
+    : data_(data), size_(size), source_fd_(source_fd), fd_(fd), dirty_(dirty), on_progress_(on_progress),
+      adapter_(std::make_shared<FileOutputAdapter>(fd, on_progress)) {}
+
+  void Run(const ordered_json& root) {
+    size_t begin = 0;
+    // UTF-8のBOMは読み込み時に読み飛ばされている
+    if (size_ >= 3 && std::memcmp(data_, "\xEF\xBB\xBF", 3) == 0) begin = 3;
+    begin = SkipSpace(begin);
+    // 末尾の空白はルートの値に含めない。走査を二度しないよう、値の終わりは括弧の対応をたどらずに求める
+    size_t end = size_;
+    while (end > begin && std::strchr(" \t\r\n", data_[end - 1])) --end;
+    DetectIndent(begin, end);
+    serializer_.emplace(adapter_, indent_char_);
+    if (Visit(root, begin) != end) throw LayoutMismatch();
+    Copy(cursor_, size_);
+    adapter_->Flush();
+  }
+
+ private:
+  /// @brief 最初に字下げされた行から、インデントの文字と幅を決める。ルートの値の中に改行が無ければ改行せずに直列化する
+  void DetectIndent(size_t begin, size_t end) {
+    const char* newline = static_cast<const char*>(std::memchr(data_ + begin, '\n', end - begin));
+    pretty_ = newline != nullptr;
+    for (; newline; newline = static_cast<const char*>(std::memchr(newline + 1, '\n', data_ + end - (newline + 1)))) {
+      const char* line = newline + 1;
+      if (line >= data_ + end || (*line != ' ' && *line != '\t')) continue;
+      indent_char_ = *line;
+      const char* text = line;
+      while (text < data_ + end && *text == indent_char_) ++text;
+      indent_width_ = static_cast<unsigned int>(text - line);
+      break;
+    }
+  }
+
+  /// @brief 値を書く。変更の無い範囲は後でまとめて写すため、ここでは読み飛ばすだけ
+  /// @return 元のファイルでの値の終わりの次の位置
+  size_t Visit(const ordered_json& value, size_t begin) {
+    if (dirty_.Contains(path_)) {
+      const size_t end = SkipValue(begin);
+      Copy(cursor_, begin);
+      if (pretty_) {
+        serializer_->dump(value, true, false, indent_width_, LineIndent(begin));
+      } else {
+        serializer_->dump(value, false, false, 0);
+      }
+      cursor_ = end;
+      return end;
+    }
+    if (!dirty_.ContainsBelow(path_)) return SkipValue(begin);
+    return WriteChildren(value, begin);
+  }
+
+  /// @brief 変更を含むコンテナの子を、元のファイルの並びに沿って書く。
+  /// 変更を含む子の間は区切りを数えるだけで読み飛ばし、キーは変更を含む子についてだけ確かめる
+  /// @return 元のファイルでのコンテナの終わりの次の位置
+  size_t WriteChildren(const ordered_json& value, size_t begin) {
+    const bool is_object = data_[begin] == '{';
+    if (is_object ? !value.is_object() : (data_[begin] != '[' || !value.is_array())) throw LayoutMismatch();
+    const char close = is_object ? '}' : ']';
+    // 変更を含む子の、現在の値での位置
+    struct Target {
+      size_t index;
+      std::string key;
+      const ordered_json* value;
+    };
+    std::vector<Target> targets;
+    const std::vector<std::string> keys = dirty_.ChildrenBelow(path_);
+    // basic_jsonのイテレーターや添字は共有中のコンテナを複製するため、コンテナにconstで触れる
+    if (is_object) {
+      size_t index = 0;
+      for (const auto& [key, child] : value.get_ref<const ordered_json::object_t&>()) {
+        if (std::binary_search(keys.begin(), keys.end(), key)) targets.push_back({index, key, &child});
+        ++index;
+      }
+    } else {
+      const auto& array = value.get_ref<const ordered_json::array_t&>();
+      for (const auto& key : keys) {
+        const size_t index = std::stoull(key);
+        if (index < array.size()) targets.push_back({index, key, &array[index]});
+      }
+      std::sort(targets.begin(), targets.end(), [](const Target& a, const Target& b) { return a.index < b.index; });
+    }
+    const size_t count = value.size();
+    size_t position = SkipSpace(begin + 1);
+    if ((data_[position] == close) != (count == 0)) throw LayoutMismatch();
+    size_t index = 0;
+    for (const auto& [target, key, child] : targets) {
+      position = SkipChildren(position, target - index);
+      if (data_[position] == close) throw LayoutMismatch();
+      size_t value_begin = position;
+      if (is_object) {
+        if (data_[position] != '"') throw LayoutMismatch();
+        const size_t key_end = SkipString(position);
+        if (!KeyEquals(position, key_end, key)) throw LayoutMismatch();
+        position = SkipSpace(key_end);
+        if (data_[position] != ':') throw LayoutMismatch();
+        value_begin = SkipSpace(position + 1);
+      }
+      path_.push_back(key);
+      position = SkipSpace(Visit(*child, value_begin));
+      path_.pop_back();
+      index = target + 1;
+      if (data_[position] == ',') {
+        position = SkipSpace(position + 1);
+      } else if (data_[position] != close) {
+        throw LayoutMismatch();
+      }
+    }
+    // 残りの子を読み飛ばし、子の数が一致することを確かめる
+    position = SkipChildren(position, count - index);
+    if (data_[position] != close) throw LayoutMismatch();
+    return position + 1;
+  }
+
+  /// @brief 位置を含む行の字下げの幅
+  unsigned int LineIndent(size_t position) const {
+    size_t line = position;
+    while (line > 0 && data_[line - 1] != '\n') --line;
+    size_t text = line;
+    while (text < position && data_[text] == indent_char_) ++text;
+    return static_cast<unsigned int>(text - line);
+  }
+
+  bool KeyEquals(size_t begin, size_t end, const std::string& key) const {
+    const std::string_view raw(data_ + begin + 1, end - begin - 2);
+    if (raw.find('\\') == std::string_view::npos) return raw == key;
+    // エスケープを含むキーは解析して比べる
+    return ordered_json::parse(data_ + begin, data_ + end).get_ref<const std::string&>() == key;
+  }
+
+  size_t SkipSpace(size_t position) const {
+    while (position < size_ && (data_[position] == ' ' || data_[position] == '\t' || data_[position] == '\n' || data_[position] == '\r')) {
+      ++position;
+    }
+    if (position >= size_) throw LayoutMismatch();
+    return position;
+  }
+
+  /// @brief 文字列の終わりの次の位置。positionは開きの引用符
+  size_t SkipString(size_t position) const {
+    size_t search = position + 1;
+    while (true) {
+      const char* quote = static_cast<const char*>(std::memchr(data_ + search, '"', size_ - search));
+      if (!quote) throw LayoutMismatch();
+      const size_t close = quote - data_;
+      // 直前のバックスラッシュが偶数個なら閉じの引用符
+      size_t backslashes = 0;
+      while (close - backslashes > position + 1 && data_[close - backslashes - 1] == '\\') ++backslashes;
+      if (backslashes % 2 == 0) return close + 1;
+      search = close + 1;
+    }
+  }
+
+  /// @brief 値の終わりの次の位置。中身は解析せず、括弧の対応だけをたどる
+  size_t SkipValue(size_t position) const {
+    const char first = data_[position];
+    if (first == '"') return SkipString(position);
+    if (first != '{' && first != '[') {
+      while (position < size_ && !std::strchr(",}] \t\r\n", data_[position])) ++position;
+      return position;
+    }
+    size_t depth = 0;
+    for (size_t i = position; i < size_; ++i) {
+      switch (data_[i]) {
+        case '"':
+          i = SkipString(i) - 1;
+          break;
+        case '{':
+        case '[':
+          ++depth;
+          break;
+        case '}':
+        case ']':
+          if (--depth == 0) return i + 1;
+          break;
+        default:
+          break;
+      }
+    }
+    throw LayoutMismatch();
+  }
+
+  /// @brief コンテナの子をcount個読み飛ばす。positionは子の先頭か、子が無ければ閉じ括弧
+  /// @return 次の子の先頭。読み飛ばした子が最後の子なら閉じ括弧の位置
+  size_t SkipChildren(size_t position, size_t count) const {
+    if (count == 0) return position;
+    size_t depth = 0;
+    for (size_t i = position; i < size_; ++i) {
+      switch (data_[i]) {
+        case '"':
+          i = SkipString(i) - 1;
+          break;
+        case '{':
+        case '[':
+          ++depth;
+          break;
+        case '}':
+        case ']':
+          if (depth == 0) {
+            // 子が足りないままコンテナが閉じた
+            if (count != 1 || i == position) throw LayoutMismatch();
+            return i;
+          }
+          --depth;
+          break;
+        case ',':
+          if (depth == 0 && --count == 0) return SkipSpace(i + 1);
+          break;
+        default:
+          break;
+      }
+    }
+    throw LayoutMismatch();
+  }
+
+  /// @brief 元のファイルの範囲をそのまま書く
+  void Copy(size_t begin, size_t end) {
+    if (begin >= end) return;
+    const size_t length = end - begin;
+    if (length < kCopyRangeThreshold || !copy_range_) {
+      adapter_->write_characters(data_ + begin, length);
+      return;
+    }
+    adapter_->Flush();
+    loff_t offset = static_cast<loff_t>(begin);
+    size_t remaining = length;
+    while (remaining > 0) {
+      const ssize_t copied = ::copy_file_range(source_fd_, &offset, fd_, nullptr, std::min(remaining, kCopyChunkSize), 0);
+      if (copied > 0) {
+        remaining -= copied;
+        if (on_progress_) on_progress_(copied);
+        continue;
+      }
+      if (copied < 0 && errno == EINTR) continue;
+      if (copied == 0 || (errno != ENOSYS && errno != EXDEV && errno != EINVAL && errno != EOPNOTSUPP)) {
+        throw std::system_error(copied == 0 ? EIO : errno, std::generic_category(), "copy_file_range");
+      }
+      // 使えないファイルシステムでは、以降は通常の書き込みで写す
+      copy_range_ = false;
+      adapter_->write_characters(data_ + offset, remaining);
+      return;
+    }
+  }
+
+  const char* data_;
+  size_t size_;
+  int source_fd_;
+  int fd_;
+  const DirtySet& dirty_;
+  const std::function<void(size_t)>& on_progress_;
+  std::shared_ptr<FileOutputAdapter> adapter_;
+  // インデントの文字を決めてから作る
+  std::optional<nlohmann::detail::serializer<ordered_json>> serializer_;
+  bool pretty_ = false;
+  char indent_char_ = ' ';
+  unsigned int indent_width_ = 2;
+  bool copy_range_ = true;
+  // まだ書いていない元のファイルの範囲の先頭
+  size_t cursor_ = 0;
+  std::vector<std::string> path_;
+};
+
+}  // namespace
+
+bool WritePatchedJsonFile(const ordered_json& value, const std::string& source_path, const DirtySet& dirty, const std::string& path, std::string& error, const WriteHooks& hooks) {
+  const int source_fd = ::open(source_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (source_fd < 0) {
+    error = "Could not open " + source_path + ": " + std::strerror(errno);
+    return false;
+  }
+  struct stat status;
+  void* mapping = MAP_FAILED;
+  if (::fstat(source_fd, &status) == 0 && status.st_size > 0) {
+    mapping = ::mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, source_fd, 0);
+  }
+  if (mapping == MAP_FAILED) {
+    error = "Could not map " + source_path;
+    ::close(source_fd);
+    return false;
+  }
+  ::madvise(mapping, status.st_size, MADV_SEQUENTIAL);
+  const bool saved = ReplaceFile(path, [&](int fd) {
+    Patcher(static_cast<const char*>(mapping), status.st_size, source_fd, fd, dirty, hooks.on_progress).Run(value);
+  }, error, hooks);
+  ::munmap(mapping, status.st_size);
+  ::close(source_fd);
+  return saved;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "dirty_set.hpp"
+#include "file_stamp.hpp"
+#include "json_types.hpp"
+#include "json_writer.hpp"
+
+#include <string>
+
+/// @brief 元のファイルの書式を保ったままJSONを保存する。
+/// 変更の無い部分は元のファイルのバイト列をそのまま写し(大きな範囲はcopy_file_rangeでカーネル内で複製し)、
+/// 変更のあったサブツリーだけを直列化する。直列化する部分のインデントは元のファイルに合わせる。
+/// 元のファイル上の位置は保存のたびに変更箇所へ至る部分だけを構造走査して求め、値の解析はしない。
+/// 読み込み時に位置を記録するJSON_DIAGNOSTIC_POSITIONSは、全ての値に開始と終了の位置を持たせて値の大きさを倍にするため使わない。
+/// ルート全体が変更されていても、インデントと前後の空白は元のファイルに合わせる。
+/// 元のファイルと値の構造が食い違えば失敗するため、呼び出し側で全体の保存へ切り替える。
+/// @param value 保存する値。
+/// @param source_path 値を読み込んだファイル。読み込んでから書き換えられていないこと。
+/// @param dirty 読み込んでから変更されたサブツリー。
+/// @param path 保存先のパス。
+/// @param[out] error 失敗した理由。
+/// @param hooks 途中経過を受け取る関数。
+/// @return 保存できたらtrue。
+bool WritePatchedJsonFile(const ordered_json& value, const std::string& source_path, const DirtySet& dirty, const std::string& path, std::string& error, const WriteHooks& hooks = {});
@@ -0,0 +1,31 @@
+#include "search_cache.hpp"
+
+#include <algorithm>
+
+SearchCacheEntry* SearchCache::Find(const std::string& query, const std::vector<std::string>& scope) {
+  for (auto iter = entries_.begin(); iter != entries_.end(); ++iter) {
+    if (iter->query == query && iter->scope == scope) {
+      entries_.splice(entries_.begin(), entries_, iter);
+      return &entries_.front();
+    }
+  }
+  return nullptr;
+}
+
+SearchCacheEntry& SearchCache::Store(SearchCacheEntry entry) {
+  entries_.remove_if([&entry](const SearchCacheEntry& e) {
+    return e.query == entry.query && e.scope == entry.scope;
+  });
+  entries_.push_front(std::move(entry));
+  while (entries_.size() > kMaxEntries) {
+    entries_.pop_back();
+  }
+  return entries_.front();
+}
+
+void SearchCache::Invalidate(const std::vector<std::string>& modified_path) {
+  entries_.remove_if([&modified_path](const SearchCacheEntry& e) {
+    return e.scope.size() >= modified_path.size()
+      && std::equal(modified_path.begin(), modified_path.end(), e.scope.begin());
+  });
+}
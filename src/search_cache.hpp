@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <vector>
+
+/// @brief 検索で見つかった1件。
+struct SearchHit {
+  std::vector<std::string> path;
+  std::string label;
+};
+
+/// @brief 検索範囲の直下の子1つ分の検索結果。
+struct SearchPartition {
+  std::string key;
+  std::vector<SearchHit> hits;
+};
+
+/// @brief (クエリ, 範囲, バージョン)に対する検索結果。
+struct SearchCacheEntry {
+  std::string query;
+  std::vector<std::string> scope;
+  uint64_t version;
+  std::vector<SearchPartition> partitions;
+};
+
+/// @brief 検索結果をLRUで保持する。
+class SearchCache {
+ public:
+  /// @brief クエリと範囲が一致するエントリーを探す。
+  /// @param query 検索クエリ。
+  /// @param scope 検索範囲のパス。
+  /// @return 見つかったエントリー。なければnullptr。
+  SearchCacheEntry* Find(const std::string& query, const std::vector<std::string>& scope);
+
+  /// @brief エントリーを保存する。同じクエリと範囲のエントリーは置き換えられる。
+  /// @param entry 保存するエントリー。
+  /// @return 保存されたエントリー。
+  SearchCacheEntry& Store(SearchCacheEntry entry);
+
+  /// @brief 変更されたサブツリーの内側を範囲とするエントリーを破棄する。
+  /// 範囲が変更箇所を含むエントリーは、パーティション単位でバージョンにより検証される。
+  /// @param modified_path 変更されたサブツリーへのパス。
+  void Invalidate(const std::vector<std::string>& modified_path);
+
+ private:
+  static constexpr size_t kMaxEntries = 16;
+  std::list<SearchCacheEntry> entries_;
+};
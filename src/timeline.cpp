@@ -0,0 +1,150 @@
+#include "timeline.hpp"
+
+#include <algorithm>
+
+Timeline::~Timeline() {
+  for (auto& checkpoint : checkpoints_) {
+    ReleaseJson(checkpoint.document);
+  }
+}
+
+void Timeline::Reset(ordered_json document) {
+  for (auto& checkpoint : checkpoints_) {
+    ReleaseJson(checkpoint.document);
+  }
+  checkpoints_.clear();
+  auto first_op = std::find_if(steps_.begin(), steps_.end(), [](const Step& step) { return step.offset != kNoOp; });
+  if (first_op != steps_.end()) log_.Truncate(first_op->offset);
+  steps_.clear();
+  interval_ = kInitialInterval;
+  since_checkpoint_ = 0;
+  periodic_count_ = 0;
+  truncated_ = false;
+  steps_.push_back({kNoOp, false, std::chrono::system_clock::now(), "", sizeof(Step)});
+  checkpoints_.push_back({0, std::move(document), std::vector<std::string>{}, sizeof(Checkpoint)});
+  used_bytes_ = sizeof(Step) + sizeof(Checkpoint);
+}
+
+void Timeline::RecordOp(const EditOp& op, bool undo, ordered_json value, std::string focus_key, const ordered_json& document) {
+  size_t bytes = sizeof(Step) + focus_key.capacity() + EstimateJsonBytes(value);
+  const uint64_t offset = log_.Append(op, std::move(value));
+  bytes += log_.End() - offset;
+  steps_.push_back({offset, undo, std::chrono::system_clock::now(), std::move(focus_key), bytes});
+  used_bytes_ += bytes;
+  if (++since_checkpoint_ < interval_) return;
+  AddCheckpoint({steps_.size() - 1, document, std::nullopt});
+  since_checkpoint_ = 0;
+  ++periodic_count_;
+  Thin();
+}
+
+void Timeline::RecordSnapshot(ordered_json document, std::vector<std::string> path, std::string focus_key) {
+  const size_t bytes = sizeof(Step) + focus_key.capacity();
+  steps_.push_back({kNoOp, false, std::chrono::system_clock::now(), std::move(focus_key), bytes});
+  used_bytes_ += bytes;
+  AddCheckpoint({steps_.size() - 1, std::move(document), std::move(path)});
+  since_checkpoint_ = 0;
+}
+
+size_t Timeline::Size() const {
+  return steps_.size();
+}
+
+size_t Timeline::UsedBytes() const {
+  return used_bytes_ + log_.PathBytes();
+}
+
+bool Timeline::Truncated() const {
+  return truncated_;
+}
+
+void Timeline::Evict(size_t budget) {
+  while (UsedBytes() > budget && checkpoints_.size() > 1) {
+    // 2番目のチェックポイントより前の時点は、最も古いチェックポイントからしか組み立てられない
+    const size_t drop = checkpoints_[1].step;
+    std::optional<uint64_t> last_offset;
+    for (size_t i = 0; i < drop; ++i) {
+      used_bytes_ -= steps_[i].bytes;
+      if (steps_[i].offset != kNoOp) last_offset = steps_[i].offset;
+    }
+    // ログ上の操作は時点と同じ順に並ぶため、捨てる時点の最後の操作までをまとめて捨てる
+    if (last_offset) log_.DropThrough(*last_offset);
+    steps_.erase(steps_.begin(), steps_.begin() + drop);
+    Checkpoint& oldest = checkpoints_.front();
+    used_bytes_ -= oldest.bytes;
+    if (!oldest.path) --periodic_count_;
+    ReleaseJson(oldest.document);
+    checkpoints_.pop_front();
+    for (auto& checkpoint : checkpoints_) {
+      checkpoint.step -= drop;
+    }
+    truncated_ = true;
+  }
+}
+
+TimelinePoint Timeline::Point(size_t step) {
+  const Step& point = steps_.at(step);
+  TimelinePoint result{point.time, {}, point.focus_key};
+  if (point.offset != kNoOp) {
+    result.path = *log_.Read(point.offset).path;
+  } else {
+    result.path = FindCheckpoint(step)->path.value_or(std::vector<std::string>{});
+  }
+  return result;
+}
+
+void Timeline::Seek(size_t step, ordered_json& document, const Applier& apply) {
+  step = std::min(step, steps_.size() - 1);
+  auto checkpoint = FindCheckpoint(step);
+  // 置き換える前のドキュメントは他の時点と構造を共有しているため、複製せずに手放す
+  ordered_json previous = checkpoint->document;
+  document.swap(previous);
+  ReleaseJson(previous);
+  for (size_t i = checkpoint->step + 1; i <= step; ++i) {
+    EditOp op = log_.Read(steps_[i].offset);
+    // ログの値は次の再生でも使うため、構造を共有する複製を渡す
+    ordered_json value = op.value ? *op.value : ordered_json();
+    op.value = &value;
+    apply(op, steps_[i].undo);
+    ReleaseJson(value);
+  }
+}
+
+std::deque<Timeline::Checkpoint>::iterator Timeline::FindCheckpoint(size_t step) {
+  auto iter = std::upper_bound(checkpoints_.begin(), checkpoints_.end(), step, [](size_t value, const Checkpoint& checkpoint) {
+    return value < checkpoint.step;
+  });
+  return std::prev(iter);
+}
+
+void Timeline::AddCheckpoint(Checkpoint checkpoint) {
+  // 直前のチェックポイントから変わった部分は、直前のチェックポイントだけが保持している
+  Checkpoint& last = checkpoints_.back();
+  used_bytes_ -= last.bytes;
+  last.bytes = sizeof(Checkpoint) + EstimateJsonBytes(last.document);
+  used_bytes_ += last.bytes;
+  checkpoint.bytes = sizeof(Checkpoint);
+  used_bytes_ += checkpoint.bytes;
+  checkpoints_.push_back(std::move(checkpoint));
+}
+
+void Timeline::Thin() {
+  if (periodic_count_ <= kMaxCheckpoints) return;
+  // 間隔で取ったものだけを、最新を残して1つおきに捨てる。隣り合うチェックポイントの間は倍の間隔以下に収まる
+  bool drop = true;
+  std::deque<Checkpoint> kept;
+  for (auto iter = checkpoints_.rbegin(); iter != checkpoints_.rend(); ++iter) {
+    if (!iter->path) {
+      drop = !drop;
+      if (drop) {
+        used_bytes_ -= iter->bytes;
+        ReleaseJson(iter->document);
+        --periodic_count_;
+        continue;
+      }
+    }
+    kept.push_front(std::move(*iter));
+  }
+  checkpoints_.swap(kept);
+  interval_ *= 2;
+}
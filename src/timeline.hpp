@@ -0,0 +1,128 @@
+#pragma once
+
+#include "edit_log.hpp"
+#include "json_types.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+/// @brief タイムライン上の1時点の情報
+struct TimelinePoint {
+  std::chrono::system_clock::time_point time;
+  // 変更のあった場所
+  std::vector<std::string> path;
+  std::string focus_key;
+};
+
+/// @brief 開いてから辿った全ての状態を時刻順に記録し、任意の時点の状態を組み立てる。
+/// Undo/Redoも1時点として記録するため、枝へ移った後でも以前の状態をたどれる。
+/// 一定の間隔でドキュメントの複製をチェックポイントとして残し、その間の操作はEditLogに詰めて記録する。
+/// 複製は構造を共有するためO(1)で取れ、ある時点へは直前のチェックポイントから間隔以下の操作を再生するだけで移れる。
+/// チェックポイントが増えすぎたら1つおきに捨てて間隔を倍にするため、数は時点の数によらず一定以下に収まる。
+/// 記録が使うメモリはおおよそのバイト数で数え、上限を超えたら古いチェックポイントごとにそれ以前の時点を捨てる。
+class Timeline {
+ public:
+  static constexpr size_t kInitialInterval = 256;
+  static constexpr size_t kMaxCheckpoints = 64;
+
+  /// @brief 操作を実行する関数。undoがtrueなら逆操作を行う。
+  using Applier = std::function<void(const EditOp& op, bool undo)>;
+
+  Timeline() = default;
+  Timeline(const Timeline&) = delete;
+  Timeline& operator=(const Timeline&) = delete;
+
+  /// @brief チェックポイントを複製せずに手放す。
+  ~Timeline();
+
+  /// @brief 記録を捨て、最初の時点を設定する。
+  /// @param document 最初の時点のドキュメント。構造を共有したまま保持する。
+  void Reset(ordered_json document);
+
+  /// @brief ログの操作で移った時点を追加する。
+  /// @param op 実行した操作。valueは使わない。
+  /// @param undo 逆操作として実行したか。
+  /// @param value 操作でドキュメントに入った値。
+  /// @param focus_key 変更のあったノードのキー。
+  /// @param document 操作の後のドキュメント。チェックポイントを取るときに複製する。
+  void RecordOp(const EditOp& op, bool undo, ordered_json value, std::string focus_key, const ordered_json& document);
+
+  /// @brief ログの操作で表せない変更で移った時点を追加する。必ずチェックポイントになる。
+  /// @param document 変更の後のドキュメント。構造を共有したまま保持する。
+  /// @param path 変更のあった場所。
+  /// @param focus_key 変更のあったノードのキー。
+  void RecordSnapshot(ordered_json document, std::vector<std::string> path, std::string focus_key);
+
+  /// @brief 時点の数。最初の時点を含む。
+  size_t Size() const;
+
+  /// @brief 記録が使っているおおよそのバイト数。
+  size_t UsedBytes() const;
+
+  /// @brief 古い時点を捨てたことがあるか。捨てた後は最初の時点が開いたときの状態ではなくなる。
+  bool Truncated() const;
+
+  /// @brief 使用量が上限に収まるまで、最も古いチェックポイントとそこから次のチェックポイントまでの時点を捨てる。
+  /// 最新のチェックポイント以降は常に残す。
+  /// @param budget 上限のバイト数。
+  void Evict(size_t budget);
+
+  /// @brief 時点の情報を得る。
+  /// @param step 時点の番号。
+  TimelinePoint Point(size_t step);
+
+  /// @brief 時点の状態を組み立てる。
+  /// @param step 時点の番号。
+  /// @param document 置き換えるドキュメント。直前のチェックポイントの複製に置き換えてから操作を再生する。
+  /// @param apply documentに操作を実行する関数。
+  void Seek(size_t step, ordered_json& document, const Applier& apply);
+
+ private:
+  static constexpr uint64_t kNoOp = UINT64_MAX;
+
+  struct Step {
+    // ログ上の操作の位置。チェックポイントだけの時点ではkNoOp
+    uint64_t offset = kNoOp;
+    // 逆操作として実行したか
+    bool undo = false;
+    std::chrono::system_clock::time_point time;
+    std::string focus_key;
+    // 時点の記録に使ったおおよそのバイト数
+    size_t bytes = 0;
+  };
+
+  struct Checkpoint {
+    size_t step = 0;
+    // その時点のドキュメント。ドキュメントと構造を共有する
+    ordered_json document;
+    // ログの操作で表せない時点の変更箇所。このチェックポイントは間引かない
+    std::optional<std::vector<std::string>> path;
+    // 現在のドキュメントと共有していない部分のおおよそのバイト数。次のチェックポイントを取るときに数える
+    size_t bytes = 0;
+  };
+
+  /// @brief 時点以前で最も新しいチェックポイント。
+  std::deque<Checkpoint>::iterator FindCheckpoint(size_t step);
+
+  /// @brief チェックポイントを追加する。直前のチェックポイントが保持している分をこの時点で数える。
+  void AddCheckpoint(Checkpoint checkpoint);
+
+  /// @brief 間隔で取ったチェックポイントが上限を超えたら、1つおきに捨てて間隔を倍にする。
+  void Thin();
+
+  EditLog log_;
+  std::vector<Step> steps_;
+  std::deque<Checkpoint> checkpoints_;
+  size_t interval_ = kInitialInterval;
+  // 最後のチェックポイントから記録した操作の数と、間隔で取ったチェックポイントの数
+  size_t since_checkpoint_ = 0;
+  size_t periodic_count_ = 0;
+  size_t used_bytes_ = 0;
+  bool truncated_ = false;
+};
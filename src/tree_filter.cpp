@@ -0,0 +1,59 @@
+#include "tree_filter.hpp"
+
+void TreeFilter::Reset() {
+  bits_.clear();
+  marked_.clear();
+  ancestors_.clear();
+  next_id_ = 1;
+}
+
+uint32_t TreeFilter::Push(uint32_t id, size_t child_count) {
+  const uint32_t first_child = next_id_;
+  next_id_ += static_cast<uint32_t>(child_count);
+  ancestors_.push_back({id, first_child});
+  // 子を走査する前に一致したコンテナは、祖先として記録されないためここで最初の子を残す
+  auto iter = marked_.find(id);
+  if (iter != marked_.end()) iter->second.first_child = first_child;
+  return first_child;
+}
+
+void TreeFilter::Pop() {
+  ancestors_.pop_back();
+}
+
+void TreeFilter::MarkHit(uint32_t id) {
+  Mark(id);
+  for (const auto& ancestor : ancestors_) {
+    Mark(ancestor.id).first_child = ancestor.first_child;
+  }
+}
+
+bool TreeFilter::Contains(uint32_t id) const {
+  const size_t word = id / 64;
+  return word < bits_.size() && (bits_[word] >> (id % 64)) & 1;
+}
+
+uint32_t TreeFilter::MatchCount(uint32_t id) const {
+  auto iter = marked_.find(id);
+  return iter == marked_.end() ? 0 : iter->second.match_count;
+}
+
+uint32_t TreeFilter::FirstChild(uint32_t id) const {
+  auto iter = marked_.find(id);
+  return iter == marked_.end() ? 0 : iter->second.first_child;
+}
+
+bool TreeFilter::Empty() const {
+  return marked_.empty();
+}
+
+TreeFilter::MarkedNode& TreeFilter::Mark(uint32_t id) {
+  const size_t word = id / 64;
+  if (word >= bits_.size()) {
+    bits_.resize(word + 1);
+  }
+  bits_[word] |= uint64_t{1} << (id % 64);
+  MarkedNode& node = marked_[id];
+  ++node.match_count;
+  return node;
+}
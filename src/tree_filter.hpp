@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/// @brief 検索に一致したノードとその祖先の集合。
+/// ノードIDは検索の走査中に割り当てられ、同じ親を持つ子には連続したIDが振られる。
+class TreeFilter {
+ public:
+  /// @brief 範囲のルート(ID 0)だけの状態に戻す。
+  void Reset();
+
+  /// @brief 走査中のコンテナに入り、その子にIDを割り当てる。
+  /// @param id コンテナのID。
+  /// @param child_count 子の数。
+  /// @return 最初の子のID。
+  uint32_t Push(uint32_t id, size_t child_count);
+
+  /// @brief 走査中のコンテナから出る。
+  void Pop();
+
+  /// @brief ノードが一致したことを記録する。走査中の全ての祖先も記録される。
+  /// @param id 一致したノードのID。
+  void MarkHit(uint32_t id);
+
+  /// @brief ノードが一致したノードか、その祖先か。
+  bool Contains(uint32_t id) const;
+
+  /// @brief ノードの子孫(自身を含む)で一致した数を得る。
+  uint32_t MatchCount(uint32_t id) const;
+
+  /// @brief 一致したコンテナか一致したノードの祖先について、最初の子のIDを得る。
+  /// @return 記録されていなければ0。
+  uint32_t FirstChild(uint32_t id) const;
+
+  /// @brief 一致したノードが一つもないか。
+  bool Empty() const;
+
+ private:
+  struct MarkedNode {
+    uint32_t first_child = 0;
+    uint32_t match_count = 0;
+  };
+  struct Ancestor {
+    uint32_t id;
+    uint32_t first_child;
+  };
+
+  /// @brief ノードを集合に加え、一致数を数える。
+  MarkedNode& Mark(uint32_t id);
+
+  std::vector<uint64_t> bits_;
+  std::unordered_map<uint32_t, MarkedNode> marked_;
+  std::vector<Ancestor> ancestors_;
+  uint32_t next_id_ = 1;
+};